@@ -0,0 +1,307 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <strings.h>
+#include <glib.h>
+
+#include "nd-action-button.h"
+
+#define ACTION_ICON_SIZE 20
+
+struct NdActionButtonPrivate
+{
+        char      *key;
+        char      *label;
+        gboolean   use_icon;
+
+        GtkWidget *image;
+        GtkWidget *text;
+};
+
+static void     nd_action_button_finalize    (GObject       *object);
+
+G_DEFINE_TYPE_WITH_PRIVATE (NdActionButton, nd_action_button, GTK_TYPE_BUTTON)
+
+static void
+nd_action_button_class_init (NdActionButtonClass *klass)
+{
+        GObjectClass   *object_class = G_OBJECT_CLASS (klass);
+
+        object_class->finalize = nd_action_button_finalize;
+}
+
+static void
+nd_action_button_init (NdActionButton *button)
+{
+        GtkWidget *hbox;
+
+        button->priv = nd_action_button_get_instance_private (button);
+
+        gtk_button_set_relief (GTK_BUTTON (button), GTK_RELIEF_NONE);
+        gtk_container_set_border_width (GTK_CONTAINER (button), 0);
+
+        hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        gtk_widget_show (hbox);
+        gtk_container_add (GTK_CONTAINER (button), hbox);
+
+        /* Only one of the image and the label is shown at a time, so
+           keep gtk_widget_show_all() on the bubble away from them */
+        button->priv->image = gtk_image_new ();
+        gtk_widget_set_no_show_all (button->priv->image, TRUE);
+        gtk_box_pack_start (GTK_BOX (hbox), button->priv->image, FALSE, FALSE, 0);
+        gtk_widget_set_halign (button->priv->image, GTK_ALIGN_CENTER);
+        gtk_widget_set_valign (button->priv->image, GTK_ALIGN_CENTER);
+
+        button->priv->text = gtk_label_new (NULL);
+        gtk_widget_set_no_show_all (button->priv->text, TRUE);
+        gtk_box_pack_start (GTK_BOX (hbox), button->priv->text, FALSE, FALSE, 0);
+        gtk_label_set_xalign (GTK_LABEL (button->priv->text), 0.0);
+}
+
+static void
+nd_action_button_finalize (GObject *object)
+{
+        NdActionButton *button;
+
+        g_return_if_fail (object != NULL);
+        g_return_if_fail (ND_IS_ACTION_BUTTON (object));
+
+        button = ND_ACTION_BUTTON (object);
+
+        g_return_if_fail (button->priv != NULL);
+
+        g_free (button->priv->key);
+        g_free (button->priv->label);
+
+        G_OBJECT_CLASS (nd_action_button_parent_class)->finalize (object);
+}
+
+static void
+clear_icon (gpointer data)
+{
+        if (data != NULL)
+                g_object_unref (data);
+}
+
+static void
+on_icon_theme_changed (GtkIconTheme *theme,
+                       GHashTable   *icons)
+{
+        g_hash_table_remove_all (icons);
+}
+
+/* Action icons are shared by all bubbles and dock rows on a screen.
+ * Failed lookups are remembered too, so that unknown action keys
+ * do not hit the icon theme on every update.
+ */
+static GdkPixbuf *
+lookup_action_icon (GtkWidget  *widget,
+                    const char *key)
+{
+        GtkIconTheme *theme;
+        GHashTable   *icons;
+        gpointer      pixbuf;
+
+        theme = gtk_icon_theme_get_for_screen (gtk_widget_get_screen (widget));
+
+        icons = g_object_get_data (G_OBJECT (theme), "nd-action-icons");
+        if (icons == NULL) {
+                icons = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               g_free,
+                                               clear_icon);
+                g_object_set_data_full (G_OBJECT (theme),
+                                        "nd-action-icons",
+                                        icons,
+                                        (GDestroyNotify) g_hash_table_destroy);
+                g_signal_connect (theme,
+                                  "changed",
+                                  G_CALLBACK (on_icon_theme_changed),
+                                  icons);
+        }
+
+        if (g_hash_table_lookup_extended (icons, key, NULL, &pixbuf))
+                return pixbuf;
+
+        pixbuf = gtk_icon_theme_load_icon (theme,
+                                           key,
+                                           ACTION_ICON_SIZE,
+                                           GTK_ICON_LOOKUP_USE_BUILTIN,
+                                           NULL);
+        g_hash_table_insert (icons, g_strdup (key), pixbuf);
+
+        return pixbuf;
+}
+
+void
+nd_action_button_set_action (NdActionButton *button,
+                             const char     *key,
+                             const char     *label,
+                             gboolean        use_icon)
+{
+        GdkPixbuf *pixbuf;
+        char      *buf;
+
+        g_return_if_fail (ND_IS_ACTION_BUTTON (button));
+
+        if (g_strcmp0 (button->priv->key, key) == 0
+            && g_strcmp0 (button->priv->label, label) == 0
+            && button->priv->use_icon == use_icon) {
+                return;
+        }
+
+        g_free (button->priv->key);
+        button->priv->key = g_strdup (key);
+        g_free (button->priv->label);
+        button->priv->label = g_strdup (label);
+        button->priv->use_icon = use_icon;
+
+        pixbuf = NULL;
+        /* try to load an icon if requested */
+        if (use_icon) {
+                pixbuf = lookup_action_icon (GTK_WIDGET (button), key);
+        }
+
+        if (pixbuf != NULL) {
+                gtk_image_set_from_pixbuf (GTK_IMAGE (button->priv->image), pixbuf);
+                atk_object_set_name (gtk_widget_get_accessible (GTK_WIDGET (button)),
+                                     label);
+                gtk_widget_show (button->priv->image);
+                gtk_widget_hide (button->priv->text);
+        } else {
+                buf = g_strdup_printf ("<small>%s</small>", label);
+                gtk_label_set_markup (GTK_LABEL (button->priv->text), buf);
+                g_free (buf);
+                gtk_widget_show (button->priv->text);
+                gtk_widget_hide (button->priv->image);
+        }
+}
+
+const char *
+nd_action_button_get_key (NdActionButton *button)
+{
+        g_return_val_if_fail (ND_IS_ACTION_BUTTON (button), NULL);
+
+        return button->priv->key;
+}
+
+GtkWidget *
+nd_action_button_new (void)
+{
+        return g_object_new (ND_TYPE_ACTION_BUTTON, NULL);
+}
+
+/* Binds the buttons in @box to the actions of @notification, reusing
+ * the existing buttons in order and only creating or destroying the
+ * difference.  Returns the number of buttons shown.
+ */
+int
+nd_action_buttons_update (GtkBox         *box,
+                          NdNotification *notification,
+                          GCallback       callback,
+                          gpointer        user_data)
+{
+        GList     *children;
+        GList     *l;
+        char     **actions;
+        gboolean   use_icons;
+        int        n_actions;
+        int        i;
+
+        g_return_val_if_fail (GTK_IS_BOX (box), 0);
+        g_return_val_if_fail (notification != NULL, 0);
+
+        children = gtk_container_get_children (GTK_CONTAINER (box));
+        l = children;
+
+        actions = nd_notification_get_actions (notification);
+        use_icons = nd_notification_get_action_icons (notification);
+        n_actions = 0;
+
+        for (i = 0; actions[i] != NULL; i += 2) {
+                char      *label = actions[i + 1];
+                GtkWidget *button;
+
+                if (label == NULL) {
+                        g_warning ("Label not found for action %s. "
+                                   "The protocol specifies that a label must "
+                                   "follow an action in the actions array",
+                                   actions[i]);
+
+                        break;
+                }
+
+                if (strcasecmp (actions[i], "default") == 0)
+                        continue;
+
+                if (l != NULL) {
+                        button = l->data;
+                        l = l->next;
+                } else {
+                        button = nd_action_button_new ();
+                        gtk_box_pack_start (box, button, FALSE, FALSE, 0);
+                        g_signal_connect (G_OBJECT (button),
+                                          "button-release-event",
+                                          callback,
+                                          user_data);
+                }
+
+                nd_action_button_set_action (ND_ACTION_BUTTON (button),
+                                             actions[i],
+                                             label,
+                                             use_icons);
+                gtk_widget_show (button);
+                n_actions++;
+        }
+
+        for (; l != NULL; l = l->next) {
+                gtk_widget_destroy (l->data);
+        }
+
+        g_list_free (children);
+
+        return n_actions;
+}
+
+/* The number of buttons nd_action_buttons_update() would show for
+ * @notification, without building them.
+ */
+int
+nd_action_buttons_count (NdNotification *notification)
+{
+        char **actions;
+        int    n_actions;
+        int    i;
+
+        g_return_val_if_fail (notification != NULL, 0);
+
+        actions = nd_notification_get_actions (notification);
+        n_actions = 0;
+
+        for (i = 0; actions[i] != NULL && actions[i + 1] != NULL; i += 2) {
+                if (strcasecmp (actions[i], "default") != 0)
+                        n_actions++;
+        }
+
+        return n_actions;
+}
@@ -0,0 +1,67 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ND_ACTION_BUTTON_H
+#define __ND_ACTION_BUTTON_H
+
+#include <gtk/gtk.h>
+#include "nd-notification.h"
+
+G_BEGIN_DECLS
+
+#define ND_TYPE_ACTION_BUTTON         (nd_action_button_get_type ())
+#define ND_ACTION_BUTTON(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), ND_TYPE_ACTION_BUTTON, NdActionButton))
+#define ND_ACTION_BUTTON_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), ND_TYPE_ACTION_BUTTON, NdActionButtonClass))
+#define ND_IS_ACTION_BUTTON(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), ND_TYPE_ACTION_BUTTON))
+#define ND_IS_ACTION_BUTTON_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), ND_TYPE_ACTION_BUTTON))
+#define ND_ACTION_BUTTON_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), ND_TYPE_ACTION_BUTTON, NdActionButtonClass))
+
+typedef struct NdActionButtonPrivate NdActionButtonPrivate;
+
+typedef struct
+{
+        GtkButton              parent;
+        NdActionButtonPrivate *priv;
+} NdActionButton;
+
+typedef struct
+{
+        GtkButtonClass   parent_class;
+} NdActionButtonClass;
+
+GType               nd_action_button_get_type               (void);
+
+GtkWidget *         nd_action_button_new                    (void);
+
+void                nd_action_button_set_action             (NdActionButton *button,
+                                                             const char     *key,
+                                                             const char     *label,
+                                                             gboolean        use_icon);
+const char *        nd_action_button_get_key                (NdActionButton *button);
+
+int                 nd_action_buttons_update                (GtkBox         *box,
+                                                             NdNotification *notification,
+                                                             GCallback       callback,
+                                                             gpointer        user_data);
+int                 nd_action_buttons_count                 (NdNotification *notification);
+
+G_END_DECLS
+
+#endif /* __ND_ACTION_BUTTON_H */
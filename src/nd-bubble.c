@@ -26,7 +26,10 @@
 #include <glib/gi18n.h>
 
 #include "nd-notification.h"
+#include "nd-action-button.h"
 #include "nd-bubble.h"
+#include "nd-layout-cache.h"
+#include "nd-watchdog.h"
 
 #define ND_BUBBLE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ND_TYPE_BUBBLE, NdBubblePrivate))
 
@@ -34,16 +37,26 @@
 #define EXPIRATION_TIME_NEVER_EXPIRES 0
 #define TIMEOUT_SEC   5
 
-#define WIDTH         400
+#define WIDTH         ND_LAYOUT_WIDTH
 #define DEFAULT_X0    0
 #define DEFAULT_Y0    0
 #define DEFAULT_RADIUS 16
-#define IMAGE_SIZE    48
+#define IMAGE_SIZE    ND_LAYOUT_IMAGE_SIZE
 #define BODY_X_OFFSET (IMAGE_SIZE + 8)
+#define BORDER_WIDTH  12
 #define BACKGROUND_ALPHA    0.90
 
 #define MAX_ICON_SIZE IMAGE_SIZE
 
+typedef struct
+{
+        int             summary_height;
+        int             body_height;
+        int             icon_height;
+        int             n_actions;
+        gboolean        has_value;
+} BubbleLayout;
+
 struct NdBubblePrivate
 {
         NdNotification *notification;
@@ -55,27 +68,46 @@ struct NdBubblePrivate
         GtkWidget      *close_button;
         GtkWidget      *body_label;
         GtkWidget      *actions_box;
+        GtkWidget      *progress_bar;
         GtkWidget      *last_sep;
 
         int             width;
         int             height;
-        int             last_width;
-        int             last_height;
+        int             text_width;
+
+        /* Rounded background at the current size, so that a child
+           update only repaints the background under that child */
+        cairo_surface_t *background;
+
+        /* Size request, kept until the wrapped text or the
+           rows around it change */
+        BubbleLayout    layout;
+        GtkRequisition  size;
+        gboolean        size_valid;
 
         gboolean        have_icon;
         gboolean        have_body;
         gboolean        have_actions;
 
+        /* Value-only updates are applied on the next frame, so a
+           sender streaming progress costs one redraw per frame */
+        guint           value_tick_id;
+
         gboolean        url_clicked_lock;
 
         gboolean        composited;
         glong           remaining;
         guint           timeout_id;
+
+        /* The expiry is paused while the pointer is over the bubble */
+        gboolean        hovered;
 };
 
 static void     nd_bubble_finalize    (GObject       *object);
-static void     on_notification_changed (NdNotification *notification,
+static void     on_notification_changed (GObject        *binding,
                                          NdBubble       *bubble);
+static void     on_notification_value_changed (GObject        *binding,
+                                               NdBubble       *bubble);
 
 G_DEFINE_TYPE_WITH_PRIVATE (NdBubble, nd_bubble, GTK_TYPE_WINDOW)
 
@@ -87,20 +119,44 @@ nd_bubble_get_notification (NdBubble *bubble)
         return bubble->priv->notification;
 }
 
+static void
+invalidate_background (NdBubble *bubble)
+{
+        g_clear_pointer (&bubble->priv->background, cairo_surface_destroy);
+}
+
 static gboolean
 nd_bubble_configure_event (GtkWidget         *widget,
                            GdkEventConfigure *event)
 {
         NdBubble *bubble = ND_BUBBLE (widget);
 
+        /* moves do not need a repaint */
+        if (bubble->priv->width == event->width
+            && bubble->priv->height == event->height) {
+                return FALSE;
+        }
+
         bubble->priv->width = event->width;
         bubble->priv->height = event->height;
 
+        invalidate_background (bubble);
         gtk_widget_queue_draw (widget);
 
         return FALSE;
 }
 
+static void
+nd_bubble_style_updated (GtkWidget *widget)
+{
+        NdBubble *bubble = ND_BUBBLE (widget);
+
+        bubble->priv->size_valid = FALSE;
+        invalidate_background (bubble);
+
+        GTK_WIDGET_CLASS (nd_bubble_parent_class)->style_updated (widget);
+}
+
 static void
 nd_bubble_composited_changed (GtkWidget *widget)
 {
@@ -118,6 +174,7 @@ nd_bubble_composited_changed (GtkWidget *widget)
 
         gtk_widget_set_visual (GTK_WIDGET (bubble), visual);
 
+        invalidate_background (bubble);
         gtk_widget_queue_draw (widget);
 }
 
@@ -206,28 +263,31 @@ get_background_color (GtkStyleContext *context,
 }
 
 static void
-paint_bubble (NdBubble *bubble,
-              cairo_t  *cr)
+ensure_background (NdBubble *bubble,
+                   cairo_t  *cr)
 {
         GtkStyleContext *context;
         GdkRGBA          bg;
         GdkRGBA          fg;
         cairo_t         *cr2;
-        cairo_surface_t *surface;
         cairo_region_t  *region;
         GtkAllocation    allocation;
 
+        if (bubble->priv->background != NULL) {
+                return;
+        }
+
         gtk_widget_get_allocation (GTK_WIDGET (bubble), &allocation);
         if (bubble->priv->width == 0 || bubble->priv->height == 0) {
                 bubble->priv->width = MAX (allocation.width, 1);
                 bubble->priv->height = MAX (allocation.height, 1);
         }
 
-        surface = cairo_surface_create_similar (cairo_get_target (cr),
-                                                CAIRO_CONTENT_COLOR_ALPHA,
-                                                bubble->priv->width,
-                                                bubble->priv->height);
-        cr2 = cairo_create (surface);
+        bubble->priv->background = cairo_surface_create_similar (cairo_get_target (cr),
+                                                                 CAIRO_CONTENT_COLOR_ALPHA,
+                                                                 bubble->priv->width,
+                                                                 bubble->priv->height);
+        cr2 = cairo_create (bubble->priv->background);
 
         /* transparent background */
         cairo_rectangle (cr2, 0, 0, bubble->priv->width, bubble->priv->height);
@@ -263,33 +323,31 @@ paint_bubble (NdBubble *bubble,
 
         cairo_destroy (cr2);
 
-        cairo_save (cr);
-        cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-        cairo_set_source_surface (cr, surface, 0, 0);
-        cairo_paint (cr);
-        cairo_restore (cr);
-
-        if (bubble->priv->width == bubble->priv->last_width
-            && bubble->priv->height == bubble->priv->last_height) {
-                goto done;
-        }
-
         /* Don't shape when composited */
         if (bubble->priv->composited) {
                 gtk_widget_shape_combine_region (GTK_WIDGET (bubble), NULL);
-                goto done;
+                return;
         }
 
-        bubble->priv->last_width = bubble->priv->width;
-        bubble->priv->last_height = bubble->priv->height;
-
-        region = gdk_cairo_region_create_from_surface (surface);
+        region = gdk_cairo_region_create_from_surface (bubble->priv->background);
         gtk_widget_shape_combine_region (GTK_WIDGET (bubble), region);
         cairo_region_destroy (region);
+}
 
- done:
-        cairo_surface_destroy (surface);
+/* Only restores the background within the clip, which GTK limits to
+ * the invalidated children.
+ */
+static void
+paint_bubble (NdBubble *bubble,
+              cairo_t  *cr)
+{
+        ensure_background (bubble, cr);
 
+        cairo_save (cr);
+        cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface (cr, bubble->priv->background, 0, 0);
+        cairo_paint (cr);
+        cairo_restore (cr);
 }
 
 static gboolean
@@ -327,6 +385,8 @@ timeout_bubble (NdBubble *bubble)
 {
         bubble->priv->timeout_id = 0;
 
+        nd_watchdog_trace ("bubble-timeout");
+
         /* FIXME: if transient also close it */
 
         gtk_widget_destroy (GTK_WIDGET (bubble));
@@ -344,7 +404,7 @@ add_timeout (NdBubble *bubble)
                 bubble->priv->timeout_id = 0;
         }
 
-        if (timeout == EXPIRATION_TIME_NEVER_EXPIRES)
+        if (timeout == EXPIRATION_TIME_NEVER_EXPIRES || bubble->priv->hovered)
                 return;
 
         if (timeout == EXPIRATION_TIME_DEFAULT)
@@ -363,6 +423,8 @@ nd_bubble_realize (GtkWidget *widget)
         add_timeout (bubble);
 
         GTK_WIDGET_CLASS (nd_bubble_parent_class)->realize (widget);
+
+        gdk_window_set_event_compression (gtk_widget_get_window (widget), TRUE);
 }
 
 static void
@@ -375,12 +437,33 @@ nd_bubble_get_preferred_width (GtkWidget *widget,
         }
 }
 
+/* Crossings into and out of child widgets are reported as
+   GDK_NOTIFY_INFERIOR and do not change the hover state */
+static gboolean
+nd_bubble_enter_notify_event (GtkWidget        *widget,
+                              GdkEventCrossing *event)
+{
+        NdBubble *bubble = ND_BUBBLE (widget);
+
+        if (event->detail == GDK_NOTIFY_INFERIOR || bubble->priv->hovered)
+                return FALSE;
+
+        bubble->priv->hovered = TRUE;
+        add_timeout (bubble);
+
+        return FALSE;
+}
+
 static gboolean
-nd_bubble_motion_notify_event (GtkWidget      *widget,
-                               GdkEventMotion *event)
+nd_bubble_leave_notify_event (GtkWidget        *widget,
+                              GdkEventCrossing *event)
 {
         NdBubble *bubble = ND_BUBBLE (widget);
 
+        if (event->detail == GDK_NOTIFY_INFERIOR || !bubble->priv->hovered)
+                return FALSE;
+
+        bubble->priv->hovered = FALSE;
         add_timeout (bubble);
 
         return FALSE;
@@ -397,43 +480,107 @@ nd_bubble_class_init (NdBubbleClass *klass)
         widget_class->draw = nd_bubble_draw;
         widget_class->configure_event = nd_bubble_configure_event;
         widget_class->composited_changed = nd_bubble_composited_changed;
+        widget_class->style_updated = nd_bubble_style_updated;
         widget_class->button_release_event = nd_bubble_button_release_event;
-        widget_class->motion_notify_event = nd_bubble_motion_notify_event;
+        widget_class->enter_notify_event = nd_bubble_enter_notify_event;
+        widget_class->leave_notify_event = nd_bubble_leave_notify_event;
         widget_class->realize = nd_bubble_realize;
         widget_class->get_preferred_width = nd_bubble_get_preferred_width;
 }
 
+/* Fallback opener, looked up once per value of $PATH */
+static gboolean  opener_resolved = FALSE;
+static char     *opener_search_path = NULL;
+static char     *opener_path = NULL;
+
+static const char *
+get_fallback_opener (void)
+{
+        const char *const openers[] = { "gvfs-open", "xdg-open", "firefox", NULL };
+        const char       *search_path;
+        int               i;
+
+        search_path = g_getenv ("PATH");
+
+        if (opener_resolved && g_strcmp0 (search_path, opener_search_path) == 0)
+                return opener_path;
+
+        g_free (opener_search_path);
+        opener_search_path = g_strdup (search_path);
+        g_clear_pointer (&opener_path, g_free);
+        opener_resolved = TRUE;
+
+        for (i = 0; openers[i] != NULL && opener_path == NULL; i++) {
+                opener_path = g_find_program_in_path (openers[i]);
+        }
+
+        return opener_path;
+}
+
+static void
+spawn_fallback_opener (const char *uri)
+{
+        const char *opener;
+        char       *argv[3];
+        GError     *error;
+
+        opener = get_fallback_opener ();
+        if (opener == NULL) {
+                g_warning ("Unable to find a browser.");
+                return;
+        }
+
+        /* No shell in between, the uri is passed as is */
+        argv[0] = (char *) opener;
+        argv[1] = (char *) uri;
+        argv[2] = NULL;
+
+        error = NULL;
+        if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DEFAULT,
+                            NULL, NULL, NULL, &error)) {
+                g_warning ("Failed to run %s: %s", opener, error->message);
+                g_error_free (error);
+        }
+}
+
+static void
+on_uri_launched (GObject      *source,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+        char   *uri = user_data;
+        GError *error;
+
+        error = NULL;
+        if (!g_app_info_launch_default_for_uri_finish (result, &error)) {
+                g_debug ("No default handler for %s: %s", uri, error->message);
+                g_error_free (error);
+
+                spawn_fallback_opener (uri);
+        }
+
+        g_free (uri);
+}
+
 static gboolean
 on_activate_link (GtkLabel *label,
                   char     *uri,
                   NdBubble *bubble)
 {
-        char *escaped_uri;
-        char *cmd = NULL;
-        char *found = NULL;
+        GdkAppLaunchContext *context;
 
         /* Somewhat of a hack.. */
         bubble->priv->url_clicked_lock = TRUE;
 
-        escaped_uri = g_shell_quote (uri);
-
-        if ((found = g_find_program_in_path ("gvfs-open")) != NULL) {
-                cmd = g_strdup_printf ("gvfs-open %s", escaped_uri);
-        } else if ((found = g_find_program_in_path ("xdg-open")) != NULL) {
-                cmd = g_strdup_printf ("xdg-open %s", escaped_uri);
-        } else if ((found = g_find_program_in_path ("firefox")) != NULL) {
-                cmd = g_strdup_printf ("firefox %s", escaped_uri);
-        } else {
-                g_warning ("Unable to find a browser.");
-        }
+        context = gdk_display_get_app_launch_context (gtk_widget_get_display (GTK_WIDGET (label)));
 
-        g_free (escaped_uri);
-        g_free (found);
+        g_app_info_launch_default_for_uri_async (uri,
+                                                 G_APP_LAUNCH_CONTEXT (context),
+                                                 NULL,
+                                                 on_uri_launched,
+                                                 g_strdup (uri));
 
-        if (cmd != NULL) {
-                g_spawn_command_line_async (cmd, NULL);
-                g_free (cmd);
-        }
+        g_object_unref (context);
 
         return TRUE;
 }
@@ -459,7 +606,7 @@ nd_bubble_init (NdBubble *bubble)
 
         bubble->priv = nd_bubble_get_instance_private (bubble);
 
-        gtk_widget_add_events (GTK_WIDGET (bubble), GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK | GDK_POINTER_MOTION_MASK);
+        gtk_widget_add_events (GTK_WIDGET (bubble), GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK | GDK_ENTER_NOTIFY_MASK | GDK_LEAVE_NOTIFY_MASK);
         atk_object_set_role (gtk_widget_get_accessible (GTK_WIDGET (bubble)), ATK_ROLE_ALERT);
 
         screen = gtk_window_get_screen (GTK_WINDOW (bubble));
@@ -477,7 +624,7 @@ nd_bubble_init (NdBubble *bubble)
         main_vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
         gtk_widget_show (main_vbox);
         gtk_container_add (GTK_CONTAINER (bubble), main_vbox);
-        gtk_container_set_border_width (GTK_CONTAINER (main_vbox), 12);
+        gtk_container_set_border_width (GTK_CONTAINER (main_vbox), BORDER_WIDTH);
 
         bubble->priv->main_hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
         gtk_widget_show (bubble->priv->main_hbox);
@@ -489,7 +636,7 @@ nd_bubble_init (NdBubble *bubble)
 
         bubble->priv->icon = gtk_image_new ();
         gtk_widget_set_valign (bubble->priv->icon, GTK_ALIGN_START);
-        gtk_widget_set_margin_top (bubble->priv->icon, 5);
+        gtk_widget_set_margin_top (bubble->priv->icon, ND_LAYOUT_ICON_MARGIN);
         gtk_widget_set_size_request (bubble->priv->icon, BODY_X_OFFSET, -1);
         gtk_widget_show (bubble->priv->icon);
 
@@ -499,10 +646,10 @@ nd_bubble_init (NdBubble *bubble)
 
         /* Add vbox */
 
-        vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+        vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, ND_LAYOUT_SPACING);
         gtk_widget_show (vbox);
         gtk_box_pack_start (GTK_BOX (bubble->priv->main_hbox), vbox, TRUE, TRUE, 0);
-        gtk_container_set_border_width (GTK_CONTAINER (vbox), 10);
+        gtk_container_set_border_width (GTK_CONTAINER (vbox), ND_LAYOUT_TEXT_BORDER);
 
         /* Add the close button */
 
@@ -544,12 +691,12 @@ nd_bubble_init (NdBubble *bubble)
         atkobj = gtk_widget_get_accessible (bubble->priv->summary_label);
         atk_object_set_description (atkobj, _("Notification summary text."));
 
-        bubble->priv->content_hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        bubble->priv->content_hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, ND_LAYOUT_SPACING);
         gtk_widget_show (bubble->priv->content_hbox);
         gtk_box_pack_start (GTK_BOX (vbox), bubble->priv->content_hbox, FALSE, FALSE, 0);
 
 
-        vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+        vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, ND_LAYOUT_SPACING);
         gtk_widget_show (vbox);
         gtk_box_pack_start (GTK_BOX (bubble->priv->content_hbox), vbox, TRUE, TRUE, 0);
 
@@ -568,11 +715,15 @@ nd_bubble_init (NdBubble *bubble)
         atkobj = gtk_widget_get_accessible (bubble->priv->body_label);
         atk_object_set_description (atkobj, _("Notification summary text."));
 
-        bubble->priv->actions_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        bubble->priv->actions_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, ND_LAYOUT_SPACING);
         gtk_widget_set_halign (bubble->priv->actions_box, GTK_ALIGN_END);
         gtk_widget_show (bubble->priv->actions_box);
 
         gtk_box_pack_start (GTK_BOX (vbox), bubble->priv->actions_box, FALSE, TRUE, 0);
+
+        bubble->priv->progress_bar = gtk_progress_bar_new ();
+        gtk_box_pack_start (GTK_BOX (vbox), bubble->priv->progress_bar, FALSE, TRUE, 0);
+        gtk_box_reorder_child (GTK_BOX (vbox), bubble->priv->progress_bar, 1);
 }
 
 static void
@@ -591,9 +742,14 @@ nd_bubble_finalize (GObject *object)
                 g_source_remove (bubble->priv->timeout_id);
         }
 
-        g_signal_handlers_disconnect_by_func (bubble->priv->notification, G_CALLBACK (on_notification_changed), bubble);
+        if (bubble->priv->value_tick_id != 0) {
+                gtk_widget_remove_tick_callback (GTK_WIDGET (bubble), bubble->priv->value_tick_id);
+        }
+
+        invalidate_background (bubble);
 
-        g_object_unref (bubble->priv->notification);
+        nd_notification_unbind (bubble->priv->notification, bubble);
+        nd_notification_unref (bubble->priv->notification);
 
         G_OBJECT_CLASS (nd_bubble_parent_class)->finalize (object);
 }
@@ -603,7 +759,8 @@ update_content_hbox_visibility (NdBubble *bubble)
 {
         if (bubble->priv->have_icon
             || bubble->priv->have_body
-            || bubble->priv->have_actions) {
+            || bubble->priv->have_actions
+            || bubble->priv->layout.has_value) {
                 gtk_widget_show (bubble->priv->content_hbox);
         } else {
                 gtk_widget_hide (bubble->priv->content_hbox);
@@ -611,35 +768,25 @@ update_content_hbox_visibility (NdBubble *bubble)
 }
 
 static void
-set_notification_text (NdBubble   *bubble,
-                       const char *summary,
-                       const char *body)
+set_notification_text (NdBubble *bubble)
 {
-        char          *str;
-        char          *quoted;
-        GtkRequisition req;
-        int            summary_width;
-
-        quoted = g_markup_escape_text (summary, -1);
-        str = g_strdup_printf ("<b><big>%s</big></b>", quoted);
-        g_free (quoted);
+        NdNotification *notification;
+        const char     *body;
+        int             summary_width;
 
-        gtk_label_set_markup (GTK_LABEL (bubble->priv->summary_label), str);
+        notification = bubble->priv->notification;
 
-        g_free (str);
-        gtk_widget_show_all (GTK_WIDGET (bubble));
+        gtk_label_set_text (GTK_LABEL (bubble->priv->summary_label),
+                            nd_notification_get_summary (notification));
+        gtk_label_set_attributes (GTK_LABEL (bubble->priv->summary_label),
+                                  nd_notification_get_summary_attrs (notification));
 
-        if (pango_parse_markup (body, -1, 0, NULL, NULL, NULL, NULL))
-                gtk_label_set_markup (GTK_LABEL (bubble->priv->body_label), body);
-        else {
-                gchar *tmp;
+        body = nd_notification_get_body_text (notification);
+        gtk_label_set_text (GTK_LABEL (bubble->priv->body_label), body);
+        gtk_label_set_attributes (GTK_LABEL (bubble->priv->body_label),
+                                  nd_notification_get_body_attrs (notification));
 
-                tmp = g_markup_escape_text (body, -1);
-                gtk_label_set_text (GTK_LABEL (bubble->priv->body_label), body);
-                g_free (tmp);
-        }
-
-        if (body == NULL || *body == '\0') {
+        if (*body == '\0') {
                 bubble->priv->have_body = FALSE;
                 gtk_widget_hide (bubble->priv->body_label);
         } else {
@@ -648,13 +795,10 @@ set_notification_text (NdBubble   *bubble,
         }
         update_content_hbox_visibility (bubble);
 
-        gtk_widget_get_preferred_size (bubble->priv->close_button, NULL, &req);
-        /* -1: main_vbox border width
-           -10: vbox border width
-           -6: spacing for hbox */
-        summary_width = WIDTH - (1*2) - (10*2) - BODY_X_OFFSET - req.width - (6*2);
+        summary_width = nd_layout_cache_get_text_width ();
+        bubble->priv->text_width = summary_width;
 
-        if (body != NULL && *body != '\0') {
+        if (*body != '\0') {
                 gtk_widget_set_size_request (bubble->priv->body_label,
                                              summary_width,
                                              -1);
@@ -728,6 +872,7 @@ set_notification_icon (NdBubble  *bubble,
                 gtk_widget_show (bubble->priv->icon);
                 gtk_widget_set_size_request (bubble->priv->icon,
                                              MAX (BODY_X_OFFSET, pixbuf_width), -1);
+                bubble->priv->layout.icon_height = gdk_pixbuf_get_height (scaled);
                 g_object_unref (scaled);
                 bubble->priv->have_icon = TRUE;
         } else {
@@ -735,6 +880,7 @@ set_notification_icon (NdBubble  *bubble,
                 gtk_widget_set_size_request (bubble->priv->icon,
                                              BODY_X_OFFSET,
                                              -1);
+                bubble->priv->layout.icon_height = 0;
                 bubble->priv->have_icon = FALSE;
         }
 
@@ -746,7 +892,7 @@ on_action_clicked (GtkButton      *button,
                    GdkEventButton *event,
                    NdBubble       *bubble)
 {
-        const char *key = g_object_get_data (G_OBJECT (button), "_action_key");
+        const char *key = nd_action_button_get_key (ND_ACTION_BUTTON (button));
         gboolean resident = nd_notification_get_is_resident (bubble->priv->notification);
         gboolean transient = nd_notification_get_is_transient (bubble->priv->notification);
 
@@ -758,151 +904,151 @@ on_action_clicked (GtkButton      *button,
 }
 
 static void
-add_notification_action (NdBubble       *bubble,
-                         const char     *text,
-                         const char     *key)
+update_actions (NdBubble *bubble)
 {
-        GtkWidget *button;
-        GtkWidget *hbox;
-        GdkPixbuf *pixbuf;
-        char      *buf;
-
-        if (!gtk_widget_get_visible (bubble->priv->actions_box)) {
-                gtk_widget_show (bubble->priv->actions_box);
-                update_content_hbox_visibility (bubble);
-        }
-
-        button = gtk_button_new ();
-        gtk_widget_show (button);
-        gtk_box_pack_start (GTK_BOX (bubble->priv->actions_box), button, FALSE, FALSE, 0);
-        gtk_button_set_relief (GTK_BUTTON (button), GTK_RELIEF_NONE);
-        gtk_container_set_border_width (GTK_CONTAINER (button), 0);
-
-        hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
-        gtk_widget_show (hbox);
-        gtk_container_add (GTK_CONTAINER (button), hbox);
-
-        pixbuf = NULL;
-        /* try to load an icon if requested */
-        if (nd_notification_get_action_icons (bubble->priv->notification)) {
-                pixbuf = gtk_icon_theme_load_icon (gtk_icon_theme_get_for_screen (gtk_widget_get_screen (GTK_WIDGET (bubble))),
-                                                   key,
-                                                   20,
-                                                   GTK_ICON_LOOKUP_USE_BUILTIN,
-                                                   NULL);
-        }
+        int n_actions;
 
-        if (pixbuf != NULL) {
-                GtkWidget *image;
-
-                image = gtk_image_new_from_pixbuf (pixbuf);
-                g_object_unref (pixbuf);
-                atk_object_set_name (gtk_widget_get_accessible (GTK_WIDGET (button)),
-                                     text);
-                gtk_widget_show (image);
-                gtk_box_pack_start (GTK_BOX (hbox), image, FALSE, FALSE, 0);
-                gtk_widget_set_halign (image, GTK_ALIGN_CENTER);
-                gtk_widget_set_valign (image, GTK_ALIGN_CENTER);
-        } else {
-                GtkWidget *label;
-
-                label = gtk_label_new (NULL);
-                gtk_widget_show (label);
-                gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 0);
-                gtk_label_set_xalign (GTK_LABEL (label), 0.0);
-                buf = g_strdup_printf ("<small>%s</small>", text);
-                gtk_label_set_markup (GTK_LABEL (label), buf);
-                g_free (buf);
-        }
+        n_actions = nd_action_buttons_update (GTK_BOX (bubble->priv->actions_box),
+                                              bubble->priv->notification,
+                                              G_CALLBACK (on_action_clicked),
+                                              bubble);
 
-        g_object_set_data_full (G_OBJECT (button),
-                                "_action_key", g_strdup (key), g_free);
-        g_signal_connect (G_OBJECT (button),
-                          "button-release-event",
-                          G_CALLBACK (on_action_clicked),
-                          bubble);
+        bubble->priv->have_actions = n_actions > 0;
+        bubble->priv->layout.n_actions = n_actions;
+        gtk_widget_set_visible (bubble->priv->actions_box, bubble->priv->have_actions);
 }
 
 static void
-clear_actions (NdBubble *bubble)
+update_image (NdBubble *bubble)
 {
-        GtkCallback callback;
-
-        callback = (void *)gtk_widget_destroy;
+        GdkPixbuf *pixbuf;
 
-        gtk_widget_hide (bubble->priv->actions_box);
-        gtk_container_foreach (GTK_CONTAINER (bubble->priv->actions_box),
-                               callback,
-                               NULL);
-        bubble->priv->have_actions = FALSE;
+        pixbuf = nd_notification_load_image (bubble->priv->notification, IMAGE_SIZE);
+        if (pixbuf != NULL) {
+                set_notification_icon (bubble, pixbuf);
+                g_object_unref (G_OBJECT (pixbuf));
+        }
 }
 
 static void
-add_actions (NdBubble *bubble)
+update_progress (NdBubble *bubble)
 {
-        char **actions;
-        int    i;
+        int value;
 
-        actions = nd_notification_get_actions (bubble->priv->notification);
+        value = nd_notification_get_value (bubble->priv->notification);
 
-        for (i = 0; actions[i] != NULL; i += 2) {
-                char *l = actions[i + 1];
-
-                if (l == NULL) {
-                        g_warning ("Label not found for action %s. "
-                                   "The protocol specifies that a label must "
-                                   "follow an action in the actions array",
-                                   actions[i]);
-
-                        break;
-                }
-
-                if (strcasecmp (actions[i], "default") != 0) {
-                        add_notification_action (bubble,
-                                                 l,
-                                                 actions[i]);
-                        bubble->priv->have_actions = TRUE;
-                }
+        bubble->priv->layout.has_value = value >= 0;
+        gtk_widget_set_visible (bubble->priv->progress_bar, value >= 0);
+        if (value >= 0) {
+                gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (bubble->priv->progress_bar),
+                                               value / 100.0);
         }
 }
 
 static void
-update_image (NdBubble *bubble)
+update_size (NdBubble     *bubble,
+             BubbleLayout *old_layout)
 {
-        GdkPixbuf *pixbuf;
+        NdBubblePrivate *priv = bubble->priv;
 
-        pixbuf = nd_notification_load_image (bubble->priv->notification, IMAGE_SIZE);
-        if (pixbuf != NULL) {
-                set_notification_icon (bubble, pixbuf);
-                g_object_unref (G_OBJECT (pixbuf));
-        }
+        priv->layout.summary_height = nd_layout_cache_get_summary_height (priv->notification,
+                                                                          priv->summary_label,
+                                                                          priv->text_width);
+        priv->layout.body_height = nd_layout_cache_get_body_height (priv->notification,
+                                                                    priv->body_label,
+                                                                    priv->text_width);
+
+        if (memcmp (&priv->layout, old_layout, sizeof (BubbleLayout)) != 0)
+                priv->size_valid = FALSE;
 }
 
 static void
 update_bubble (NdBubble *bubble)
 {
-        set_notification_text (bubble,
-                               nd_notification_get_summary (bubble->priv->notification),
-                               nd_notification_get_body (bubble->priv->notification));
-        clear_actions (bubble);
-        add_actions (bubble);
+        BubbleLayout old_layout;
+
+        old_layout = bubble->priv->layout;
+
+        set_notification_text (bubble);
+        update_actions (bubble);
         update_image (bubble);
+        update_progress (bubble);
         update_content_hbox_visibility (bubble);
+        update_size (bubble, &old_layout);
 
         add_timeout (bubble);
 }
 
 static void
-on_notification_changed (NdNotification *notification,
-                         NdBubble       *bubble)
+on_notification_changed (GObject  *binding,
+                         NdBubble *bubble)
 {
         update_bubble (bubble);
 }
 
+static gboolean
+value_tick_cb (GtkWidget     *widget,
+               GdkFrameClock *frame_clock,
+               gpointer       user_data)
+{
+        NdBubble *bubble = ND_BUBBLE (widget);
+
+        bubble->priv->value_tick_id = 0;
+
+        update_progress (bubble);
+        add_timeout (bubble);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+on_notification_value_changed (GObject  *binding,
+                               NdBubble *bubble)
+{
+        if (bubble->priv->value_tick_id != 0)
+                return;
+
+        bubble->priv->value_tick_id = gtk_widget_add_tick_callback (GTK_WIDGET (bubble),
+                                                                    value_tick_cb,
+                                                                    NULL, NULL);
+}
+
+void
+nd_bubble_get_size (NdBubble *bubble,
+                    int      *width,
+                    int      *height)
+{
+        g_return_if_fail (ND_IS_BUBBLE (bubble));
+
+        if (!bubble->priv->size_valid) {
+                gtk_widget_get_preferred_size (GTK_WIDGET (bubble),
+                                               NULL,
+                                               &bubble->priv->size);
+                bubble->priv->size_valid = TRUE;
+        }
+
+        if (width != NULL)
+                *width = bubble->priv->size.width;
+        if (height != NULL)
+                *height = bubble->priv->size.height;
+}
+
+/* The height of a bubble for @notification, so that the stack can
+ * tell whether it fits before building it.
+ */
+int
+nd_bubble_estimate_height (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, 0);
+
+        return nd_layout_cache_get_content_height (notification) + (BORDER_WIDTH*2);
+}
+
 NdBubble *
 nd_bubble_new_for_notification (NdNotification *notification)
 {
         NdBubble *bubble;
+        GObject  *binding;
 
         bubble = g_object_new (ND_TYPE_BUBBLE,
                                "app-paintable", TRUE,
@@ -912,8 +1058,10 @@ nd_bubble_new_for_notification (NdNotification *notification)
                                "type-hint", GDK_WINDOW_TYPE_HINT_NOTIFICATION,
                                NULL);
 
-        bubble->priv->notification = g_object_ref (notification);
-        g_signal_connect (notification, "changed", G_CALLBACK (on_notification_changed), bubble);
+        bubble->priv->notification = nd_notification_ref (notification);
+        binding = nd_notification_bind (notification);
+        g_signal_connect (binding, "changed", G_CALLBACK (on_notification_changed), bubble);
+        g_signal_connect (binding, "value-changed", G_CALLBACK (on_notification_value_changed), bubble);
         update_bubble (bubble);
 
         return bubble;
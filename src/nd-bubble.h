@@ -54,6 +54,10 @@ GType               nd_bubble_get_type                      (void);
 NdBubble *          nd_bubble_new_for_notification          (NdNotification *notification);
 
 NdNotification *    nd_bubble_get_notification              (NdBubble       *bubble);
+int                 nd_bubble_estimate_height               (NdNotification *notification);
+void                nd_bubble_get_size                      (NdBubble       *bubble,
+                                                             int            *width,
+                                                             int            *height);
 
 G_END_DECLS
 
@@ -20,23 +20,53 @@
 
 #include "config.h"
 
+#include <fcntl.h>
 #include <glib/gi18n.h>
+#include <gio/gunixfdlist.h>
 #include <gtk/gtk.h>
 
 #include "nd-daemon.h"
+#include "nd-dispatcher.h"
 #include "nd-fd-notifications.h"
+#include "nd-id-allocator.h"
+#include "nd-inhibitor.h"
 #include "nd-notification.h"
 #include "nd-queue.h"
+#include "nd-sender-registry.h"
+#include "nd-socket-listener.h"
+#include "nd-string-pool.h"
+#include "nd-watchdog.h"
 
 #define NOTIFICATIONS_DBUS_NAME "org.freedesktop.Notifications"
 #define NOTIFICATIONS_DBUS_PATH "/org/freedesktop/Notifications"
+#define NOTIFICATIONS_DBUS_IFACE "org.freedesktop.Notifications"
 
 #define INFO_NAME "Notification Daemon"
 #define INFO_VENDOR "GNOME"
 #define INFO_VERSION PACKAGE_VERSION
 #define INFO_SPEC_VERSION "1.2"
 
-#define MAX_NOTIFICATIONS 20
+#define DEFAULT_MAX_NOTIFICATIONS 20
+
+/* A quarter of the ids, so that new ones are quickly found even while
+ * notifications wait to be evicted.
+ */
+#define MAX_NOTIFICATIONS_LIMIT 16384
+
+typedef enum
+{
+  ORPHAN_POLICY_EXPIRE,
+  ORPHAN_POLICY_DEMOTE,
+  ORPHAN_POLICY_KEEP
+} OrphanPolicy;
+
+typedef enum
+{
+  OVERFLOW_POLICY_REJECT,
+  OVERFLOW_POLICY_EVICT_LOW_URGENCY,
+  OVERFLOW_POLICY_EVICT_SAME_SENDER,
+  OVERFLOW_POLICY_COLLAPSE
+} OverflowPolicy;
 
 struct _NdDaemon
 {
@@ -46,15 +76,121 @@ struct _NdDaemon
 
   NdFdNotifications *notifications;
   guint              bus_name_id;
+  GDBusConnection   *connection;
+
+  /* D-Bus methods are handled on the dispatcher thread, everything
+   * that touches the queue runs on the main thread.
+   */
+  NdDispatcher      *dispatcher;
+
+  /* Ids handed out to clients and not yet closed, shared between
+   * both threads.
+   */
+  NdIdAllocator     *ids;
+
+  /* Outgoing signals, flushed once per main loop iteration */
+  GArray            *pending_signals;
+  guint              flush_signals_id;
+  gboolean           unicast_signals;
+
+  /* What happens to new notifications once max_notifications are
+   * stored.  Rejections are counted on the dispatcher thread.
+   */
+  guint              max_notifications;
+  OverflowPolicy     overflow_policy;
+  gint               n_overflow_rejected;
+  guint              n_evicted_low_urgency;
+  guint              n_evicted_same_sender;
+  guint              n_collapsed;
+  guint              n_overflow_dropped;
+
+  /* Notifications by sender, to handle clients leaving the bus */
+  NdSenderRegistry  *senders;
+  OrphanPolicy       orphan_policy;
+  guint              n_orphaned;
+
+  /* Do not disturb, with cookies handed out on the dispatcher thread */
+  NdInhibitor       *inhibitor;
+  gint               last_cookie;
+
+  /* Side channel for bulk producers, served on the dispatcher thread */
+  gboolean           socket;
+  NdSocketListener  *socket_listener;
+  gint               n_socket_received;
+  gint               n_socket_rejected;
+
+  /* Reports main loop iterations that take too long */
+  NdWatchdog        *watchdog;
 
   NdQueue           *queue;
 };
 
+typedef enum
+{
+  RECORD_NOTIFY,
+  RECORD_CLOSE,
+  RECORD_BATCH,
+  RECORD_INHIBIT,
+  RECORD_UNINHIBIT,
+  RECORD_GET_STATISTICS
+} RecordType;
+
+typedef enum
+{
+  SIGNAL_NOTIFICATION_CLOSED,
+  SIGNAL_ACTION_INVOKED
+} SignalType;
+
+typedef struct
+{
+  SignalType   type;
+  guint        id;
+  guint        reason;
+  gchar       *action;
+
+  /* From the string pool */
+  const gchar *destination;
+} PendingSignal;
+
+/* A parsed request, built on the dispatcher thread and never changed
+ * after it has been pushed to the main thread.
+ */
+typedef struct
+{
+  RecordType             type;
+  guint                  id;
+  gboolean               replaces;
+
+  gchar                 *sender;
+  gchar                 *app_name;
+  gchar                 *app_icon;
+  gchar                 *summary;
+  gchar                 *body;
+  gchar                **actions;
+  GHashTable            *hints;
+  gint                   expire_timeout;
+  gchar                 *reason;
+
+  GPtrArray             *records;
+
+  GDBusMethodInvocation *invocation;
+  NdSocketClient        *client;
+} Record;
+
 enum
 {
   PROP_0,
 
   PROP_REPLACE,
+  PROP_MEMORY_BUDGET,
+  PROP_UNICAST_SIGNALS,
+  PROP_ORPHAN_POLICY,
+  PROP_ANIMATE,
+  PROP_SINGLE_SURFACE,
+  PROP_SOCKET,
+  PROP_MAX_NOTIFICATIONS,
+  PROP_OVERFLOW_POLICY,
+  PROP_STALL_THRESHOLD,
 
   LAST_PROP
 };
@@ -63,19 +199,197 @@ static GParamSpec *properties[LAST_PROP] = { NULL };
 
 G_DEFINE_TYPE (NdDaemon, nd_daemon, G_TYPE_OBJECT)
 
+static Record *
+record_new (RecordType type,
+            guint      id)
+{
+  Record *record;
+
+  record = g_slice_new0 (Record);
+  record->type = type;
+  record->id = id;
+
+  return record;
+}
+
+static Record *
+notify_record_new (guint               id,
+                   gboolean            replaces,
+                   const gchar        *sender,
+                   const gchar        *app_name,
+                   const gchar        *app_icon,
+                   const gchar        *summary,
+                   const gchar        *body,
+                   const gchar *const *actions,
+                   GVariant           *hints,
+                   GUnixFDList        *fd_list,
+                   gint                expire_timeout)
+{
+  Record *record;
+
+  record = record_new (RECORD_NOTIFY, id);
+  record->replaces = replaces;
+  record->sender = g_strdup (sender);
+  record->app_name = g_strdup (app_name);
+  record->app_icon = g_strdup (app_icon);
+  record->summary = g_strdup (summary);
+  record->body = g_strdup (body);
+  record->actions = g_strdupv ((gchar **) actions);
+  record->hints = nd_notification_parse_hints (hints, fd_list);
+  record->expire_timeout = expire_timeout;
+
+  return record;
+}
+
+static void
+record_free (gpointer data)
+{
+  Record *record;
+
+  record = data;
+
+  g_free (record->sender);
+  g_free (record->app_name);
+  g_free (record->app_icon);
+  g_free (record->summary);
+  g_free (record->body);
+  g_strfreev (record->actions);
+  g_clear_pointer (&record->hints, g_hash_table_unref);
+  g_free (record->reason);
+  g_clear_pointer (&record->records, g_ptr_array_unref);
+
+  /* Only still set when the record was dropped at shutdown */
+  if (record->invocation != NULL)
+    g_dbus_method_invocation_return_error (record->invocation,
+                                           G_DBUS_ERROR,
+                                           G_DBUS_ERROR_FAILED,
+                                           _("The notification server is shutting down"));
+
+  if (record->client != NULL)
+    nd_socket_client_release (record->client);
+
+  g_slice_free (Record, record);
+}
+
+static void
+pending_signal_clear (gpointer data)
+{
+  PendingSignal *pending;
+
+  pending = data;
+
+  g_free (pending->action);
+  nd_string_pool_release (pending->destination);
+}
+
+static void
+emit_signal (NdDaemon      *daemon,
+             PendingSignal *pending)
+{
+  GError *error;
+
+  if (!daemon->unicast_signals || daemon->connection == NULL ||
+      pending->destination == NULL)
+    {
+      if (pending->type == SIGNAL_NOTIFICATION_CLOSED)
+        nd_fd_notifications_emit_notification_closed (daemon->notifications,
+                                                      pending->id,
+                                                      pending->reason);
+      else
+        nd_fd_notifications_emit_action_invoked (daemon->notifications,
+                                                 pending->id, pending->action);
+
+      return;
+    }
+
+  error = NULL;
+
+  if (pending->type == SIGNAL_NOTIFICATION_CLOSED)
+    g_dbus_connection_emit_signal (daemon->connection, pending->destination,
+                                   NOTIFICATIONS_DBUS_PATH,
+                                   NOTIFICATIONS_DBUS_IFACE,
+                                   "NotificationClosed",
+                                   g_variant_new ("(uu)", pending->id,
+                                                  pending->reason),
+                                   &error);
+  else
+    g_dbus_connection_emit_signal (daemon->connection, pending->destination,
+                                   NOTIFICATIONS_DBUS_PATH,
+                                   NOTIFICATIONS_DBUS_IFACE,
+                                   "ActionInvoked",
+                                   g_variant_new ("(us)", pending->id,
+                                                  pending->action),
+                                   &error);
+
+  if (error != NULL)
+    {
+      g_debug ("Failed to emit signal to %s: %s",
+               pending->destination, error->message);
+      g_error_free (error);
+    }
+}
+
+static gboolean
+flush_signals_cb (gpointer user_data)
+{
+  NdDaemon *daemon;
+  guint i;
+
+  daemon = ND_DAEMON (user_data);
+  daemon->flush_signals_id = 0;
+
+  nd_watchdog_trace ("flush-signals");
+
+  for (i = 0; i < daemon->pending_signals->len; i++)
+    emit_signal (daemon, &g_array_index (daemon->pending_signals,
+                                         PendingSignal, i));
+
+  g_array_set_size (daemon->pending_signals, 0);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+queue_signal (NdDaemon       *daemon,
+              SignalType      type,
+              NdNotification *notification,
+              guint           reason,
+              const gchar    *action)
+{
+  PendingSignal pending;
+
+  pending.type = type;
+  pending.id = nd_notification_get_id (notification);
+  pending.reason = reason;
+  pending.action = g_strdup (action);
+  pending.destination = nd_string_pool_intern (nd_notification_get_sender (notification));
+
+  g_array_append_val (daemon->pending_signals, pending);
+
+  if (daemon->flush_signals_id == 0)
+    daemon->flush_signals_id = g_idle_add (flush_signals_cb, daemon);
+}
+
+/* The daemon is told about every notification, including the
+ * summaries of the queue, which have no id.
+ */
 static void
 closed_cb (NdNotification *notification,
            gint            reason,
            gpointer        user_data)
 {
   NdDaemon *daemon;
-  gint id;
 
   daemon = ND_DAEMON (user_data);
-  id = nd_notification_get_id (notification);
 
-  nd_fd_notifications_emit_notification_closed (daemon->notifications,
-                                                id, reason);
+  if (nd_notification_get_id (notification) == 0)
+    return;
+
+  nd_id_allocator_release (daemon->ids, nd_notification_get_id (notification));
+  nd_sender_registry_remove (daemon->senders, notification);
+
+  queue_signal (daemon, SIGNAL_NOTIFICATION_CLOSED, notification,
+                reason, NULL);
 }
 
 static void
@@ -84,19 +398,343 @@ action_invoked_cb (NdNotification *notification,
                    gpointer        user_data)
 {
   NdDaemon *daemon;
-  gint id;
 
   daemon = ND_DAEMON (user_data);
-  id = nd_notification_get_id (notification);
 
-  nd_fd_notifications_emit_action_invoked (daemon->notifications,
-                                           id, action);
+  if (nd_notification_get_id (notification) == 0)
+    return;
+
+  queue_signal (daemon, SIGNAL_ACTION_INVOKED, notification, 0, action);
 
   /* Resident notifications does not close when actions are invoked. */
   if (!nd_notification_get_is_resident (notification))
     nd_notification_close (notification, ND_NOTIFICATION_CLOSED_USER);
 }
 
+static const NdNotificationObserver notification_observer = {
+  NULL,
+  NULL,
+  closed_cb,
+  action_invoked_cb
+};
+
+static void
+sender_vanished_cb (NdSenderRegistry *registry,
+                    const gchar      *sender,
+                    gpointer          user_data)
+{
+  NdDaemon *daemon;
+  GList *notifications;
+  GList *l;
+
+  daemon = ND_DAEMON (user_data);
+
+  if (daemon->orphan_policy == ORPHAN_POLICY_KEEP)
+    return;
+
+  notifications = nd_sender_registry_get_notifications (registry, sender);
+
+  g_list_foreach (notifications, (GFunc) nd_notification_ref, NULL);
+  nd_queue_freeze (daemon->queue);
+
+  for (l = notifications; l != NULL; l = l->next)
+    {
+      NdNotification *notification;
+
+      notification = l->data;
+      daemon->n_orphaned++;
+
+      /* Demoted notifications go away with their bubble; the ones
+       * that are only stored have none left to wait for.
+       */
+      if (daemon->orphan_policy == ORPHAN_POLICY_EXPIRE ||
+          !nd_notification_get_is_queued (notification))
+        nd_notification_close (notification, ND_NOTIFICATION_CLOSED_EXPIRED);
+      else
+        nd_notification_demote (notification);
+    }
+
+  nd_queue_thaw (daemon->queue);
+  g_list_free_full (notifications, (GDestroyNotify) nd_notification_unref);
+}
+
+static void
+inhibited_changed_cb (NdInhibitor *inhibitor,
+                      gboolean     inhibited,
+                      gpointer     user_data)
+{
+  NdDaemon *daemon;
+
+  daemon = ND_DAEMON (user_data);
+
+  nd_queue_set_inhibited (daemon->queue, inhibited);
+}
+
+/* Picks the stored notification to make room for @incoming, which may
+ * be @incoming itself.  A notification is never evicted in favour of
+ * one of lower urgency.
+ */
+static NdNotification *
+get_overflow_victim (NdDaemon       *daemon,
+                     NdNotification *incoming)
+{
+  NdNotification *victim;
+
+  if (daemon->overflow_policy == OVERFLOW_POLICY_EVICT_SAME_SENDER ||
+      daemon->overflow_policy == OVERFLOW_POLICY_COLLAPSE)
+    {
+      victim = nd_queue_get_oldest_from (daemon->queue,
+                                         nd_notification_get_sender (incoming));
+
+      if (victim != incoming &&
+          nd_notification_get_urgency (victim) <= nd_notification_get_urgency (incoming))
+        return victim;
+    }
+
+  return nd_queue_get_lowest_urgency (daemon->queue);
+}
+
+static void
+apply_overflow_policy (NdDaemon       *daemon,
+                       NdNotification *incoming)
+{
+  while (nd_queue_length (daemon->queue) > daemon->max_notifications)
+    {
+      NdNotification *victim;
+      gboolean same_sender;
+
+      victim = get_overflow_victim (daemon, incoming);
+      if (victim == NULL)
+        break;
+
+      if (victim == incoming)
+        {
+          daemon->n_overflow_dropped++;
+          nd_notification_close (incoming, ND_NOTIFICATION_CLOSED_EXPIRED);
+
+          break;
+        }
+
+      /* Senders are pooled */
+      same_sender = nd_notification_get_sender (victim) ==
+                    nd_notification_get_sender (incoming);
+
+      if (daemon->overflow_policy == OVERFLOW_POLICY_COLLAPSE && same_sender)
+        {
+          nd_notification_collapse (incoming, victim);
+          daemon->n_collapsed++;
+        }
+      else if (same_sender)
+        {
+          daemon->n_evicted_same_sender++;
+        }
+      else
+        {
+          daemon->n_evicted_low_urgency++;
+        }
+
+      nd_notification_close (victim, ND_NOTIFICATION_CLOSED_EXPIRED);
+    }
+}
+
+static void
+apply_notify (NdDaemon *daemon,
+              Record   *record)
+{
+  NdNotification *notification;
+
+  notification = NULL;
+  if (record->replaces)
+    notification = nd_queue_lookup (daemon->queue, record->id);
+
+  if (notification != NULL)
+    {
+      nd_notification_ref (notification);
+    }
+  else
+    {
+      /* The replaced notification may have been closed while the
+       * record was in flight, take its id back if nobody else did.
+       * If the slot went to another notification in the meantime the
+       * client has already been told this one is closed, so drop the
+       * update rather than show two notifications under one id.
+       */
+      if (!nd_id_allocator_is_live (daemon->ids, record->id)
+          && !nd_id_allocator_claim (daemon->ids, record->id))
+        {
+          g_debug ("Dropping update for notification %u, its id was reused",
+                   record->id);
+          return;
+        }
+
+      notification = nd_notification_new (record->sender, record->id);
+      nd_sender_registry_add (daemon->senders, notification);
+    }
+
+  nd_notification_update (notification, record->app_name, record->app_icon,
+                          record->summary, record->body,
+                          (const gchar *const *) record->actions,
+                          record->hints, record->expire_timeout);
+
+  if (!nd_notification_get_is_queued (notification))
+    {
+      nd_queue_add (daemon->queue, notification);
+      nd_notification_set_is_queued (notification, TRUE);
+    }
+
+  if (!record->replaces && daemon->overflow_policy != OVERFLOW_POLICY_REJECT)
+    apply_overflow_policy (daemon, notification);
+
+  nd_notification_unref (notification);
+}
+
+static void
+apply_close (NdDaemon *daemon,
+             Record   *record)
+{
+  NdNotification *notification;
+
+  notification = nd_queue_lookup (daemon->queue, record->id);
+
+  if (notification != NULL)
+    nd_notification_close (notification, ND_NOTIFICATION_CLOSED_API);
+}
+
+static void apply_record (gpointer data,
+                          gpointer user_data);
+
+/* Applies a whole NotifyBatch or CloseNotifications call as a single
+ * queue transaction.
+ */
+static void
+apply_batch (NdDaemon *daemon,
+             Record   *record)
+{
+  guint i;
+
+  nd_queue_freeze (daemon->queue);
+
+  for (i = 0; i < record->records->len; i++)
+    apply_record (g_ptr_array_index (record->records, i), daemon);
+
+  nd_queue_thaw (daemon->queue);
+}
+
+static void
+apply_inhibit (NdDaemon *daemon,
+               Record   *record)
+{
+  if (record->type == RECORD_INHIBIT)
+    nd_inhibitor_add (daemon->inhibitor, record->id, record->sender,
+                      record->reason);
+  else
+    nd_inhibitor_remove (daemon->inhibitor, record->id, record->sender);
+}
+
+static void
+apply_get_statistics (NdDaemon *daemon,
+                      Record   *record)
+{
+  GVariantBuilder builder;
+  guint n_unique_strings;
+  guint n_strings;
+  guint n_stalls;
+  guint longest_stall;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  nd_queue_add_statistics (daemon->queue, &builder);
+
+  nd_string_pool_get_stats (&n_unique_strings, &n_strings);
+  g_variant_builder_add (&builder, "{sv}", "strings-unique",
+                         g_variant_new_uint32 (n_unique_strings));
+  g_variant_builder_add (&builder, "{sv}", "strings-total",
+                         g_variant_new_uint32 (n_strings));
+
+  g_variant_builder_add (&builder, "{sv}", "senders",
+                         g_variant_new_uint32 (nd_sender_registry_get_n_senders (daemon->senders)));
+  g_variant_builder_add (&builder, "{sv}", "orphaned",
+                         g_variant_new_uint32 (daemon->n_orphaned));
+  g_variant_builder_add (&builder, "{sv}", "inhibitors",
+                         g_variant_new_uint32 (nd_inhibitor_get_n_cookies (daemon->inhibitor)));
+  g_variant_builder_add (&builder, "{sv}", "inhibited",
+                         g_variant_new_boolean (nd_inhibitor_get_inhibited (daemon->inhibitor)));
+  g_variant_builder_add (&builder, "{sv}", "overflow-rejected",
+                         g_variant_new_uint32 (g_atomic_int_get (&daemon->n_overflow_rejected)));
+  g_variant_builder_add (&builder, "{sv}", "overflow-evicted-low-urgency",
+                         g_variant_new_uint32 (daemon->n_evicted_low_urgency));
+  g_variant_builder_add (&builder, "{sv}", "overflow-evicted-same-sender",
+                         g_variant_new_uint32 (daemon->n_evicted_same_sender));
+  g_variant_builder_add (&builder, "{sv}", "overflow-collapsed",
+                         g_variant_new_uint32 (daemon->n_collapsed));
+  g_variant_builder_add (&builder, "{sv}", "overflow-dropped",
+                         g_variant_new_uint32 (daemon->n_overflow_dropped));
+  g_variant_builder_add (&builder, "{sv}", "socket-received",
+                         g_variant_new_uint32 (g_atomic_int_get (&daemon->n_socket_received)));
+  g_variant_builder_add (&builder, "{sv}", "socket-rejected",
+                         g_variant_new_uint32 (g_atomic_int_get (&daemon->n_socket_rejected)));
+
+  n_stalls = 0;
+  longest_stall = 0;
+  if (daemon->watchdog != NULL)
+    {
+      n_stalls = nd_watchdog_get_n_stalls (daemon->watchdog);
+      longest_stall = nd_watchdog_get_longest_stall (daemon->watchdog);
+    }
+
+  g_variant_builder_add (&builder, "{sv}", "stalls",
+                         g_variant_new_uint32 (n_stalls));
+  g_variant_builder_add (&builder, "{sv}", "longest-stall-ms",
+                         g_variant_new_uint32 (longest_stall));
+
+  nd_fd_notifications_complete_get_statistics (daemon->notifications,
+                                               g_steal_pointer (&record->invocation),
+                                               g_variant_builder_end (&builder));
+}
+
+static void
+apply_record (gpointer data,
+              gpointer user_data)
+{
+  NdDaemon *daemon;
+  Record *record;
+
+  daemon = ND_DAEMON (user_data);
+  record = data;
+
+  switch (record->type)
+    {
+      case RECORD_NOTIFY:
+        nd_watchdog_trace ("apply-notify");
+        apply_notify (daemon, record);
+        break;
+
+      case RECORD_CLOSE:
+        nd_watchdog_trace ("apply-close");
+        apply_close (daemon, record);
+        break;
+
+      case RECORD_BATCH:
+        nd_watchdog_trace ("apply-batch");
+        apply_batch (daemon, record);
+        break;
+
+      case RECORD_INHIBIT:
+      case RECORD_UNINHIBIT:
+        nd_watchdog_trace ("apply-inhibit");
+        apply_inhibit (daemon, record);
+        break;
+
+      case RECORD_GET_STATISTICS:
+        nd_watchdog_trace ("apply-get-statistics");
+        apply_get_statistics (daemon, record);
+        break;
+
+      default:
+        g_assert_not_reached ();
+        break;
+    }
+}
+
 static gboolean
 handle_close_notification_cb (NdFdNotifications     *object,
                               GDBusMethodInvocation *invocation,
@@ -106,13 +744,12 @@ handle_close_notification_cb (NdFdNotifications     *object,
   NdDaemon *daemon;
   const gchar *error_name;
   const gchar *error_message;
-  NdNotification *notification;
 
   daemon = ND_DAEMON (user_data);
   error_name = "org.freedesktop.Notifications.InvalidId";
   error_message = _("Invalid notification identifier");
 
-  if (id == 0)
+  if (!nd_id_allocator_is_live (daemon->ids, id))
     {
       g_dbus_method_invocation_return_dbus_error (invocation, error_name,
                                                   error_message);
@@ -120,17 +757,7 @@ handle_close_notification_cb (NdFdNotifications     *object,
       return TRUE;
     }
 
-  notification = nd_queue_lookup (daemon->queue, id);
-
-  if (notification == NULL)
-    {
-      g_dbus_method_invocation_return_dbus_error (invocation, error_name,
-                                                  error_message);
-
-      return TRUE;
-    }
-
-  nd_notification_close (notification, ND_NOTIFICATION_CLOSED_API);
+  nd_dispatcher_push (daemon->dispatcher, record_new (RECORD_CLOSE, id));
   nd_fd_notifications_complete_close_notification (object, invocation);
 
   return TRUE;
@@ -144,7 +771,11 @@ handle_get_capabilities_cb (NdFdNotifications     *object,
   const gchar *const capabilities[] =
   {
     "actions", "body", "body-hyperlinks", "body-markup", "icon-static",
-    "sound", "persistence", "action-icons", NULL
+    "sound", "persistence", "action-icons",
+#ifdef F_GET_SEALS
+    ND_NOTIFICATION_IMAGE_FD_HINT,
+#endif
+    NULL
   };
 
   nd_fd_notifications_complete_get_capabilities (object, invocation,
@@ -166,6 +797,90 @@ handle_get_server_information_cb (NdFdNotifications     *object,
   return TRUE;
 }
 
+static gboolean
+handle_get_statistics_cb (NdFdNotifications     *object,
+                          GDBusMethodInvocation *invocation,
+                          gpointer               user_data)
+{
+  NdDaemon *daemon;
+  Record *record;
+
+  daemon = ND_DAEMON (user_data);
+
+  /* The queue is only accessible from the main thread, which
+   * completes the invocation.
+   */
+  record = record_new (RECORD_GET_STATISTICS, 0);
+  record->invocation = invocation;
+
+  nd_dispatcher_push (daemon->dispatcher, record);
+
+  return TRUE;
+}
+
+static GUnixFDList *
+get_fd_list (GDBusMethodInvocation *invocation)
+{
+  GDBusMessage *message;
+
+  message = g_dbus_method_invocation_get_message (invocation);
+
+  return g_dbus_message_get_unix_fd_list (message);
+}
+
+/* Whether @n_new more notifications are turned away.  Other policies
+ * than reject make room on the main thread instead.
+ */
+static gboolean
+is_over_capacity (NdDaemon *daemon,
+                  guint     n_new)
+{
+  if (daemon->overflow_policy != OVERFLOW_POLICY_REJECT)
+    return FALSE;
+
+  return nd_id_allocator_get_n_live (daemon->ids) + n_new > daemon->max_notifications;
+}
+
+/* Allocates the id of a Notify request and builds its record, or
+ * returns NULL if no id is left.  Shared by the D-Bus method and the
+ * socket, and runs on the dispatcher thread.
+ */
+static Record *
+ingest_notify (NdDaemon           *daemon,
+               const gchar        *sender,
+               const gchar        *app_name,
+               guint               replaces_id,
+               const gchar        *app_icon,
+               const gchar        *summary,
+               const gchar        *body,
+               const gchar *const *actions,
+               GVariant           *hints,
+               GUnixFDList        *fd_list,
+               gint                expire_timeout)
+{
+  guint new_id;
+
+  if (!nd_id_allocator_is_live (daemon->ids, replaces_id))
+    replaces_id = 0;
+
+  if (replaces_id == 0 && is_over_capacity (daemon, 1))
+    {
+      g_atomic_int_inc (&daemon->n_overflow_rejected);
+      return NULL;
+    }
+
+  new_id = replaces_id;
+  if (new_id == 0)
+    new_id = nd_id_allocator_allocate (daemon->ids);
+
+  if (new_id == 0)
+    return NULL;
+
+  return notify_record_new (new_id, replaces_id > 0, sender,
+                            app_name, app_icon, summary, body, actions,
+                            hints, fd_list, expire_timeout);
+}
+
 static gboolean
 handle_notify_cb (NdFdNotifications     *object,
                   GDBusMethodInvocation *invocation,
@@ -182,12 +897,18 @@ handle_notify_cb (NdFdNotifications     *object,
   NdDaemon *daemon;
   const gchar *error_name;
   const gchar *error_message;
-  NdNotification *notification;
-  gint new_id;
+  Record *record;
+  guint new_id;
 
   daemon = ND_DAEMON (user_data);
 
-  if (nd_queue_length (daemon->queue) > MAX_NOTIFICATIONS)
+  record = ingest_notify (daemon,
+                          g_dbus_method_invocation_get_sender (invocation),
+                          app_name, replaces_id, app_icon, summary, body,
+                          actions, hints, get_fd_list (invocation),
+                          expire_timeout);
+
+  if (record == NULL)
     {
       error_name = "org.freedesktop.Notifications.MaxNotificationsExceeded";
       error_message = _("Exceeded maximum number of notifications");
@@ -198,50 +919,254 @@ handle_notify_cb (NdFdNotifications     *object,
       return TRUE;
     }
 
-  if (replaces_id > 0)
+  new_id = record->id;
+
+  nd_dispatcher_push (daemon->dispatcher, record);
+  nd_fd_notifications_complete_notify (object, invocation, new_id);
+
+  return TRUE;
+}
+
+/* A Notify call without a reply, with the same arguments */
+static void
+socket_frame_cb (NdSocketClient *client,
+                 GVariant       *frame,
+                 gpointer        user_data)
+{
+  NdDaemon *daemon;
+  const gchar *app_name;
+  guint replaces_id;
+  const gchar *app_icon;
+  const gchar *summary;
+  const gchar *body;
+  const gchar **actions;
+  GVariant *hints;
+  gint expire_timeout;
+  Record *record;
+
+  daemon = ND_DAEMON (user_data);
+
+  g_variant_get (frame, "(&su&s&s&s^a&s@a{sv}i)",
+                 &app_name, &replaces_id, &app_icon, &summary, &body,
+                 &actions, &hints, &expire_timeout);
+
+  record = ingest_notify (daemon, NULL, app_name, replaces_id, app_icon,
+                          summary, body, actions, hints, NULL,
+                          expire_timeout);
+
+  g_free (actions);
+  g_variant_unref (hints);
+
+  if (record == NULL)
     {
-      notification = nd_queue_lookup (daemon->queue, replaces_id);
+      g_atomic_int_inc (&daemon->n_socket_rejected);
+      return;
+    }
 
-      if (notification == NULL)
-        replaces_id = 0;
-      else
-        g_object_ref (notification);
+  /* Stops reading the client while too many of its records wait for
+   * the main thread.
+   */
+  record->client = nd_socket_client_hold (client);
+  g_atomic_int_inc (&daemon->n_socket_received);
+
+  nd_dispatcher_push (daemon->dispatcher, record);
+}
+
+static gboolean
+handle_notify_batch_cb (NdFdNotifications     *object,
+                        GDBusMethodInvocation *invocation,
+                        GVariant              *notifications,
+                        gpointer               user_data)
+{
+  NdDaemon *daemon;
+  const gchar *sender;
+  GUnixFDList *fd_list;
+  gsize n_notifications;
+  guint32 *replaces;
+  guint32 *new_ids;
+  guint n_new;
+  guint n_reserved;
+  Record *batch;
+  GVariantBuilder builder;
+  gsize i;
+  guint j;
+
+  daemon = ND_DAEMON (user_data);
+  sender = g_dbus_method_invocation_get_sender (invocation);
+  fd_list = get_fd_list (invocation);
+  n_notifications = g_variant_n_children (notifications);
+
+  replaces = g_new0 (guint32, n_notifications);
+  n_new = 0;
+
+  for (i = 0; i < n_notifications; i++)
+    {
+      g_variant_get_child (notifications, i, "(&su&s&s&s^a&s@a{sv}i)",
+                           NULL, &replaces[i], NULL, NULL, NULL, NULL,
+                           NULL, NULL);
+
+      if (!nd_id_allocator_is_live (daemon->ids, replaces[i]))
+        replaces[i] = 0;
+
+      if (replaces[i] == 0)
+        n_new++;
     }
 
-  if (replaces_id == 0)
+  new_ids = g_new0 (guint32, MAX (n_new, 1));
+  n_reserved = 0;
+
+  if (!is_over_capacity (daemon, n_new))
+    n_reserved = nd_id_allocator_reserve (daemon->ids, new_ids, n_new);
+
+  if (n_reserved < n_new)
     {
-      const gchar *sender;
+      g_atomic_int_inc (&daemon->n_overflow_rejected);
 
-      sender = g_dbus_method_invocation_get_sender (invocation);
-      notification = nd_notification_new (sender);
+      for (j = 0; j < n_reserved; j++)
+        nd_id_allocator_release (daemon->ids, new_ids[j]);
 
-      g_signal_connect (notification, "closed",
-                        G_CALLBACK (closed_cb), daemon);
-      g_signal_connect (notification, "action-invoked",
-                        G_CALLBACK (action_invoked_cb), daemon);
+      g_dbus_method_invocation_return_dbus_error (invocation,
+                                                  "org.freedesktop.Notifications.MaxNotificationsExceeded",
+                                                  _("Exceeded maximum number of notifications"));
+
+      g_free (new_ids);
+      g_free (replaces);
+
+      return TRUE;
     }
 
-  nd_notification_update (notification, app_name, app_icon, summary, body,
-                          actions, hints, expire_timeout);
+  batch = record_new (RECORD_BATCH, 0);
+  batch->records = g_ptr_array_new_full (n_notifications, record_free);
 
-  if (replaces_id == 0 || !nd_notification_get_is_queued (notification))
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("au"));
+
+  for (i = 0, j = 0; i < n_notifications; i++)
     {
-      nd_queue_add (daemon->queue, notification);
-      nd_notification_set_is_queued (notification, TRUE);
+      const gchar *app_name;
+      const gchar *app_icon;
+      const gchar *summary;
+      const gchar *body;
+      const gchar **actions;
+      GVariant *hints;
+      gint expire_timeout;
+      guint id;
+
+      g_variant_get_child (notifications, i, "(&su&s&s&s^a&s@a{sv}i)",
+                           &app_name, NULL, &app_icon, &summary, &body,
+                           &actions, &hints, &expire_timeout);
+
+      id = replaces[i] > 0 ? replaces[i] : new_ids[j++];
+
+      g_ptr_array_add (batch->records,
+                       notify_record_new (id, replaces[i] > 0, sender,
+                                          app_name, app_icon, summary, body,
+                                          actions, hints, fd_list,
+                                          expire_timeout));
+      g_variant_builder_add (&builder, "u", id);
+
+      g_free (actions);
+      g_variant_unref (hints);
     }
 
-  new_id = nd_notification_get_id (notification);
-  nd_fd_notifications_complete_notify (object, invocation, new_id);
+  nd_dispatcher_push (daemon->dispatcher, batch);
+  nd_fd_notifications_complete_notify_batch (object, invocation,
+                                             g_variant_builder_end (&builder));
 
-  g_object_unref (notification);
+  g_free (new_ids);
+  g_free (replaces);
 
   return TRUE;
 }
 
-static void
-bus_acquired_handler_cb (GDBusConnection *connection,
-                         const gchar     *name,
-                         gpointer         user_data)
+static gboolean
+handle_close_notifications_cb (NdFdNotifications     *object,
+                               GDBusMethodInvocation *invocation,
+                               GVariant              *ids,
+                               gpointer               user_data)
+{
+  NdDaemon *daemon;
+  Record *batch;
+  GVariantIter iter;
+  guint32 id;
+
+  daemon = ND_DAEMON (user_data);
+
+  batch = record_new (RECORD_BATCH, 0);
+  batch->records = g_ptr_array_new_with_free_func (record_free);
+
+  g_variant_iter_init (&iter, ids);
+  while (g_variant_iter_next (&iter, "u", &id))
+    {
+      if (nd_id_allocator_is_live (daemon->ids, id))
+        g_ptr_array_add (batch->records, record_new (RECORD_CLOSE, id));
+    }
+
+  if (batch->records->len > 0)
+    nd_dispatcher_push (daemon->dispatcher, batch);
+  else
+    record_free (batch);
+
+  nd_fd_notifications_complete_close_notifications (object, invocation);
+
+  return TRUE;
+}
+
+static gboolean
+handle_inhibit_cb (NdFdNotifications     *object,
+                   GDBusMethodInvocation *invocation,
+                   const gchar           *reason,
+                   gpointer               user_data)
+{
+  NdDaemon *daemon;
+  Record *record;
+  guint cookie;
+
+  daemon = ND_DAEMON (user_data);
+  cookie = (guint) g_atomic_int_add (&daemon->last_cookie, 1) + 1;
+
+  record = record_new (RECORD_INHIBIT, cookie);
+  record->sender = g_strdup (g_dbus_method_invocation_get_sender (invocation));
+  record->reason = g_strdup (reason);
+
+  nd_dispatcher_push (daemon->dispatcher, record);
+  nd_fd_notifications_complete_inhibit (object, invocation, cookie);
+
+  return TRUE;
+}
+
+static gboolean
+handle_un_inhibit_cb (NdFdNotifications     *object,
+                      GDBusMethodInvocation *invocation,
+                      guint                  cookie,
+                      gpointer               user_data)
+{
+  NdDaemon *daemon;
+  Record *record;
+
+  daemon = ND_DAEMON (user_data);
+
+  record = record_new (RECORD_UNINHIBIT, cookie);
+  record->sender = g_strdup (g_dbus_method_invocation_get_sender (invocation));
+
+  nd_dispatcher_push (daemon->dispatcher, record);
+  nd_fd_notifications_complete_un_inhibit (object, invocation);
+
+  return TRUE;
+}
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+  gtk_main_quit ();
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Runs on the dispatcher thread, so that method calls are delivered
+ * to its main context.
+ */
+static gboolean
+export_cb (gpointer user_data)
 {
   NdDaemon *daemon;
   GDBusInterfaceSkeleton *skeleton;
@@ -251,17 +1176,8 @@ bus_acquired_handler_cb (GDBusConnection *connection,
   daemon = ND_DAEMON (user_data);
   skeleton = G_DBUS_INTERFACE_SKELETON (daemon->notifications);
 
-  g_signal_connect (daemon->notifications, "handle-close-notification",
-                    G_CALLBACK (handle_close_notification_cb), daemon);
-  g_signal_connect (daemon->notifications, "handle-get-capabilities",
-                    G_CALLBACK (handle_get_capabilities_cb), daemon);
-  g_signal_connect (daemon->notifications, "handle-get-server-information",
-                    G_CALLBACK (handle_get_server_information_cb), daemon);
-  g_signal_connect (daemon->notifications, "handle-notify",
-                    G_CALLBACK (handle_notify_cb), daemon);
-
   error = NULL;
-  exported = g_dbus_interface_skeleton_export (skeleton, connection,
+  exported = g_dbus_interface_skeleton_export (skeleton, daemon->connection,
                                                NOTIFICATIONS_DBUS_PATH, &error);
 
   if (!exported)
@@ -269,8 +1185,68 @@ bus_acquired_handler_cb (GDBusConnection *connection,
       g_warning ("Failed to export interface: %s", error->message);
       g_error_free (error);
 
-      gtk_main_quit ();
+      g_idle_add (quit_cb, NULL);
+
+      return G_SOURCE_REMOVE;
     }
+
+  if (daemon->socket)
+    {
+      gchar *path;
+
+      path = g_build_filename (g_get_user_runtime_dir (),
+                               "notification-daemon.sock", NULL);
+
+      daemon->socket_listener = nd_socket_listener_new (G_VARIANT_TYPE ("(susssasa{sv}i)"),
+                                                        socket_frame_cb,
+                                                        daemon);
+
+      if (!nd_socket_listener_listen (daemon->socket_listener, path, &error))
+        {
+          g_warning ("Failed to listen on %s: %s", path, error->message);
+          g_error_free (error);
+
+          g_clear_object (&daemon->socket_listener);
+        }
+
+      g_free (path);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+bus_acquired_handler_cb (GDBusConnection *connection,
+                         const gchar     *name,
+                         gpointer         user_data)
+{
+  NdDaemon *daemon;
+
+  daemon = ND_DAEMON (user_data);
+
+  g_signal_connect (daemon->notifications, "handle-close-notification",
+                    G_CALLBACK (handle_close_notification_cb), daemon);
+  g_signal_connect (daemon->notifications, "handle-get-capabilities",
+                    G_CALLBACK (handle_get_capabilities_cb), daemon);
+  g_signal_connect (daemon->notifications, "handle-get-server-information",
+                    G_CALLBACK (handle_get_server_information_cb), daemon);
+  g_signal_connect (daemon->notifications, "handle-notify",
+                    G_CALLBACK (handle_notify_cb), daemon);
+  g_signal_connect (daemon->notifications, "handle-notify-batch",
+                    G_CALLBACK (handle_notify_batch_cb), daemon);
+  g_signal_connect (daemon->notifications, "handle-close-notifications",
+                    G_CALLBACK (handle_close_notifications_cb), daemon);
+  g_signal_connect (daemon->notifications, "handle-inhibit",
+                    G_CALLBACK (handle_inhibit_cb), daemon);
+  g_signal_connect (daemon->notifications, "handle-un-inhibit",
+                    G_CALLBACK (handle_un_inhibit_cb), daemon);
+  g_signal_connect (daemon->notifications, "handle-get-statistics",
+                    G_CALLBACK (handle_get_statistics_cb), daemon);
+
+  nd_inhibitor_start (daemon->inhibitor, connection);
+
+  g_set_object (&daemon->connection, connection);
+  nd_dispatcher_invoke (daemon->dispatcher, export_cb, daemon);
 }
 
 static void
@@ -308,6 +1284,21 @@ nd_daemon_dispose (GObject *object)
 
   daemon = ND_DAEMON (object);
 
+  nd_notification_remove_observer (&notification_observer, daemon);
+
+  /* Pending drains hold a reference to the dispatcher, so stop it
+   * here rather than rely on the last unref: records it still holds
+   * are dropped instead of being applied to a disposed daemon.
+   */
+  if (daemon->dispatcher != NULL)
+    nd_dispatcher_stop (daemon->dispatcher);
+
+  if (daemon->flush_signals_id > 0)
+    {
+      g_source_remove (daemon->flush_signals_id);
+      flush_signals_cb (daemon);
+    }
+
   if (daemon->notifications != NULL)
     {
       GDBusInterfaceSkeleton *skeleton;
@@ -318,17 +1309,81 @@ nd_daemon_dispose (GObject *object)
       g_clear_object (&daemon->notifications);
     }
 
+  /* The dispatcher thread is gone by now, so is anybody using the
+   * listener.
+   */
+  g_clear_object (&daemon->dispatcher);
+  g_clear_object (&daemon->socket_listener);
+
   if (daemon->bus_name_id > 0)
     {
       g_bus_unown_name (daemon->bus_name_id);
       daemon->bus_name_id = 0;
     }
 
+  g_clear_object (&daemon->connection);
+  g_clear_object (&daemon->inhibitor);
   g_clear_object (&daemon->queue);
+  g_clear_object (&daemon->senders);
+  g_clear_object (&daemon->watchdog);
 
   G_OBJECT_CLASS (nd_daemon_parent_class)->dispose (object);
 }
 
+static void
+nd_daemon_finalize (GObject *object)
+{
+  NdDaemon *daemon;
+
+  daemon = ND_DAEMON (object);
+
+  nd_id_allocator_free (daemon->ids);
+  g_array_free (daemon->pending_signals, TRUE);
+
+  G_OBJECT_CLASS (nd_daemon_parent_class)->finalize (object);
+}
+
+static void
+set_orphan_policy (NdDaemon    *daemon,
+                   const gchar *policy)
+{
+  if (g_strcmp0 (policy, "expire") == 0)
+    daemon->orphan_policy = ORPHAN_POLICY_EXPIRE;
+  else if (g_strcmp0 (policy, "demote") == 0)
+    daemon->orphan_policy = ORPHAN_POLICY_DEMOTE;
+  else if (g_strcmp0 (policy, "keep") == 0)
+    daemon->orphan_policy = ORPHAN_POLICY_KEEP;
+  else
+    g_warning ("Unknown orphan policy '%s'", policy);
+}
+
+static void
+set_overflow_policy (NdDaemon    *daemon,
+                     const gchar *policy)
+{
+  if (g_strcmp0 (policy, "reject") == 0)
+    daemon->overflow_policy = OVERFLOW_POLICY_REJECT;
+  else if (g_strcmp0 (policy, "evict-low-urgency") == 0)
+    daemon->overflow_policy = OVERFLOW_POLICY_EVICT_LOW_URGENCY;
+  else if (g_strcmp0 (policy, "evict-same-sender") == 0)
+    daemon->overflow_policy = OVERFLOW_POLICY_EVICT_SAME_SENDER;
+  else if (g_strcmp0 (policy, "collapse") == 0)
+    daemon->overflow_policy = OVERFLOW_POLICY_COLLAPSE;
+  else
+    g_warning ("Unknown overflow policy '%s'", policy);
+}
+
+/* Must be set from the main thread */
+static void
+set_stall_threshold (NdDaemon *daemon,
+                     guint     threshold)
+{
+  g_clear_object (&daemon->watchdog);
+
+  if (threshold > 0)
+    daemon->watchdog = nd_watchdog_new (threshold);
+}
+
 static void
 nd_daemon_set_property (GObject      *object,
                         guint         property_id,
@@ -345,6 +1400,44 @@ nd_daemon_set_property (GObject      *object,
         daemon->replace = g_value_get_boolean (value);
         break;
 
+      case PROP_MEMORY_BUDGET:
+        nd_queue_set_memory_budget (daemon->queue,
+                                    (gsize) g_value_get_uint (value) * 1024);
+        break;
+
+      case PROP_UNICAST_SIGNALS:
+        daemon->unicast_signals = g_value_get_boolean (value);
+        break;
+
+      case PROP_ORPHAN_POLICY:
+        set_orphan_policy (daemon, g_value_get_string (value));
+        break;
+
+      case PROP_ANIMATE:
+        nd_queue_set_animate (daemon->queue, g_value_get_boolean (value));
+        break;
+
+      case PROP_SINGLE_SURFACE:
+        nd_queue_set_single_surface (daemon->queue,
+                                     g_value_get_boolean (value));
+        break;
+
+      case PROP_SOCKET:
+        daemon->socket = g_value_get_boolean (value);
+        break;
+
+      case PROP_MAX_NOTIFICATIONS:
+        daemon->max_notifications = g_value_get_uint (value);
+        break;
+
+      case PROP_OVERFLOW_POLICY:
+        set_overflow_policy (daemon, g_value_get_string (value));
+        break;
+
+      case PROP_STALL_THRESHOLD:
+        set_stall_threshold (daemon, g_value_get_uint (value));
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
         break;
@@ -360,6 +1453,7 @@ nd_daemon_class_init (NdDaemonClass *daemon_class)
 
   object_class->constructed = nd_daemon_constructed;
   object_class->dispose = nd_daemon_dispose;
+  object_class->finalize = nd_daemon_finalize;
   object_class->set_property = nd_daemon_set_property;
 
   properties[PROP_REPLACE] =
@@ -367,6 +1461,61 @@ nd_daemon_class_init (NdDaemonClass *daemon_class)
                           G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE |
                           G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_MEMORY_BUDGET] =
+    g_param_spec_uint ("memory-budget", "memory-budget",
+                       "Memory budget of stored notifications in KiB",
+                       0, G_MAXUINT, 0,
+                       G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_UNICAST_SIGNALS] =
+    g_param_spec_boolean ("unicast-signals", "unicast-signals",
+                          "Send signals only to the client that posted "
+                          "the notification", FALSE,
+                          G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_ORPHAN_POLICY] =
+    g_param_spec_string ("orphan-policy", "orphan-policy",
+                         "What to do with the notifications of clients that "
+                         "left the bus: expire, demote or keep", "expire",
+                         G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_ANIMATE] =
+    g_param_spec_boolean ("animate", "animate",
+                          "Animate bubbles as the stack reflows", FALSE,
+                          G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_SINGLE_SURFACE] =
+    g_param_spec_boolean ("single-surface", "single-surface",
+                          "Draw the notifications of a monitor in a "
+                          "single window", FALSE,
+                          G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_SOCKET] =
+    g_param_spec_boolean ("socket", "socket",
+                          "Also accept notifications on a Unix socket in "
+                          "the user runtime directory", FALSE,
+                          G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_MAX_NOTIFICATIONS] =
+    g_param_spec_uint ("max-notifications", "max-notifications",
+                       "Number of stored notifications before the overflow "
+                       "policy applies", 1, MAX_NOTIFICATIONS_LIMIT,
+                       DEFAULT_MAX_NOTIFICATIONS,
+                       G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_OVERFLOW_POLICY] =
+    g_param_spec_string ("overflow-policy", "overflow-policy",
+                         "What to do with new notifications once too many "
+                         "are stored: reject, evict-low-urgency, "
+                         "evict-same-sender or collapse", "reject",
+                         G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_STALL_THRESHOLD] =
+    g_param_spec_uint ("stall-threshold", "stall-threshold",
+                       "Main loop iterations longer than this many ms are "
+                       "logged with a trace, 0 to disable", 0, G_MAXUINT, 0,
+                       G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, LAST_PROP, properties);
 }
 
@@ -375,6 +1524,25 @@ nd_daemon_init (NdDaemon *daemon)
 {
   daemon->notifications = nd_fd_notifications_skeleton_new ();
   daemon->queue = nd_queue_new ();
+
+  daemon->ids = nd_id_allocator_new ();
+  daemon->max_notifications = DEFAULT_MAX_NOTIFICATIONS;
+  daemon->overflow_policy = OVERFLOW_POLICY_REJECT;
+
+  daemon->senders = nd_sender_registry_new ();
+  daemon->orphan_policy = ORPHAN_POLICY_EXPIRE;
+  g_signal_connect (daemon->senders, "sender-vanished",
+                    G_CALLBACK (sender_vanished_cb), daemon);
+  daemon->inhibitor = nd_inhibitor_new ();
+  g_signal_connect (daemon->inhibitor, "inhibited-changed",
+                    G_CALLBACK (inhibited_changed_cb), daemon);
+
+  daemon->pending_signals = g_array_new (FALSE, FALSE, sizeof (PendingSignal));
+  g_array_set_clear_func (daemon->pending_signals, pending_signal_clear);
+
+  daemon->dispatcher = nd_dispatcher_new (apply_record, daemon, record_free);
+
+  nd_notification_add_observer (&notification_observer, daemon);
 }
 
 NdDaemon *
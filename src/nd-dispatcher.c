@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "nd-dispatcher.h"
+
+/*
+ * NdDispatcher runs a thread with its own main context, where D-Bus
+ * requests are handled, and hands the resulting records over to the
+ * default main context.
+ *
+ * The handoff is a lock-free stack: producers push with a compare
+ * and exchange on the head, the main thread takes the whole list at
+ * once and replays it in push order.  Only the push that finds the
+ * stack empty schedules a drain, so a burst costs a single wakeup.
+ */
+
+typedef struct _Node Node;
+
+struct _Node
+{
+  Node     *next;
+  gpointer  record;
+};
+
+struct _NdDispatcher
+{
+  GObject         parent;
+
+  GMainContext   *context;
+  GMainLoop      *loop;
+  GThread        *thread;
+
+  Node           *head;
+
+  NdDispatchFunc  func;
+  gpointer        user_data;
+  GDestroyNotify  free_record;
+};
+
+G_DEFINE_TYPE (NdDispatcher, nd_dispatcher, G_TYPE_OBJECT)
+
+static Node *
+steal_records (NdDispatcher *dispatcher)
+{
+  Node *head;
+  Node *reversed;
+
+  do
+    {
+      head = g_atomic_pointer_get (&dispatcher->head);
+    }
+  while (!g_atomic_pointer_compare_and_exchange (&dispatcher->head, head, NULL));
+
+  reversed = NULL;
+  while (head != NULL)
+    {
+      Node *next;
+
+      next = head->next;
+      head->next = reversed;
+      reversed = head;
+      head = next;
+    }
+
+  return reversed;
+}
+
+static gboolean
+drain_cb (gpointer user_data)
+{
+  NdDispatcher *dispatcher;
+  Node *node;
+
+  dispatcher = ND_DISPATCHER (user_data);
+  node = steal_records (dispatcher);
+
+  while (node != NULL)
+    {
+      Node *next;
+
+      next = node->next;
+
+      dispatcher->func (node->record, dispatcher->user_data);
+      dispatcher->free_record (node->record);
+      g_slice_free (Node, node);
+
+      node = next;
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer
+dispatch_thread_func (gpointer user_data)
+{
+  NdDispatcher *dispatcher;
+
+  dispatcher = ND_DISPATCHER (user_data);
+
+  g_main_context_push_thread_default (dispatcher->context);
+  g_main_loop_run (dispatcher->loop);
+  g_main_context_pop_thread_default (dispatcher->context);
+
+  return NULL;
+}
+
+static void
+nd_dispatcher_finalize (GObject *object)
+{
+  NdDispatcher *dispatcher;
+
+  dispatcher = ND_DISPATCHER (object);
+
+  nd_dispatcher_stop (dispatcher);
+
+  g_main_loop_unref (dispatcher->loop);
+  g_main_context_unref (dispatcher->context);
+
+  G_OBJECT_CLASS (nd_dispatcher_parent_class)->finalize (object);
+}
+
+static void
+nd_dispatcher_class_init (NdDispatcherClass *dispatcher_class)
+{
+  GObjectClass *object_class;
+
+  object_class = G_OBJECT_CLASS (dispatcher_class);
+
+  object_class->finalize = nd_dispatcher_finalize;
+}
+
+static void
+nd_dispatcher_init (NdDispatcher *dispatcher)
+{
+  dispatcher->context = g_main_context_new ();
+  dispatcher->loop = g_main_loop_new (dispatcher->context, FALSE);
+}
+
+NdDispatcher *
+nd_dispatcher_new (NdDispatchFunc func,
+                   gpointer       user_data,
+                   GDestroyNotify free_record)
+{
+  NdDispatcher *dispatcher;
+
+  dispatcher = g_object_new (ND_TYPE_DISPATCHER, NULL);
+  dispatcher->func = func;
+  dispatcher->user_data = user_data;
+  dispatcher->free_record = free_record;
+
+  dispatcher->thread = g_thread_new ("nd-dispatcher",
+                                     dispatch_thread_func,
+                                     dispatcher);
+
+  return dispatcher;
+}
+
+GMainContext *
+nd_dispatcher_get_context (NdDispatcher *dispatcher)
+{
+  return dispatcher->context;
+}
+
+/* Runs @func once in the dispatch thread. */
+void
+nd_dispatcher_invoke (NdDispatcher *dispatcher,
+                      GSourceFunc   func,
+                      gpointer      data)
+{
+  g_main_context_invoke (dispatcher->context, func, data);
+}
+
+/* Hands @record over to the default main context.  Safe to call from
+ * any thread; records are delivered in the order they were pushed.
+ */
+void
+nd_dispatcher_push (NdDispatcher *dispatcher,
+                    gpointer      record)
+{
+  Node *node;
+  Node *head;
+
+  node = g_slice_new (Node);
+  node->record = record;
+
+  do
+    {
+      head = g_atomic_pointer_get (&dispatcher->head);
+      node->next = head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange (&dispatcher->head, head, node));
+
+  if (head == NULL)
+    g_idle_add_full (G_PRIORITY_DEFAULT, drain_cb,
+                     g_object_ref (dispatcher), g_object_unref);
+}
+
+/* Stops the dispatch thread and frees the records it handed over that
+ * were not replayed yet, without replaying them.  A drain that is
+ * still scheduled then finds nothing to do, so nothing reaches the
+ * dispatch function once this returns.
+ */
+void
+nd_dispatcher_stop (NdDispatcher *dispatcher)
+{
+  Node *node;
+
+  if (dispatcher->thread == NULL)
+    return;
+
+  g_main_loop_quit (dispatcher->loop);
+  g_thread_join (dispatcher->thread);
+  dispatcher->thread = NULL;
+
+  node = steal_records (dispatcher);
+  while (node != NULL)
+    {
+      Node *next;
+
+      next = node->next;
+      dispatcher->free_record (node->record);
+      g_slice_free (Node, node);
+      node = next;
+    }
+}
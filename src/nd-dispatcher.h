@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ND_DISPATCHER_H
+#define ND_DISPATCHER_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef void (* NdDispatchFunc) (gpointer record,
+                                 gpointer user_data);
+
+#define ND_TYPE_DISPATCHER nd_dispatcher_get_type ()
+G_DECLARE_FINAL_TYPE (NdDispatcher, nd_dispatcher, ND, DISPATCHER, GObject)
+
+NdDispatcher *nd_dispatcher_new         (NdDispatchFunc  func,
+                                         gpointer        user_data,
+                                         GDestroyNotify  free_record);
+
+GMainContext *nd_dispatcher_get_context (NdDispatcher   *dispatcher);
+
+void          nd_dispatcher_invoke      (NdDispatcher   *dispatcher,
+                                         GSourceFunc     func,
+                                         gpointer        data);
+
+void          nd_dispatcher_push        (NdDispatcher   *dispatcher,
+                                         gpointer        record);
+
+void          nd_dispatcher_stop        (NdDispatcher   *dispatcher);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "nd-eviction-index.h"
+#include "nd-string-pool.h"
+
+/*
+ * Stored notifications ordered for eviction, once by urgency and age
+ * and once by age within each sender, so that the next one to go is
+ * found, added and removed in O(log n).
+ *
+ * The sort keys are copied when a notification is added, since they
+ * must not change while it is in a sequence.  A notification whose
+ * urgency or update time changed is added again to move it.
+ */
+
+typedef struct
+{
+  NdNotification *notification;
+  guint           id;
+  guint           urgency;
+  gint64          update_time;
+
+  const gchar    *sender;
+  GSequenceIter  *by_urgency;
+  GSequenceIter  *by_age;
+} Entry;
+
+struct _NdEvictionIndex
+{
+  /* id -> Entry */
+  GHashTable *entries;
+
+  /* Lowest urgency first, then oldest first */
+  GSequence  *by_urgency;
+
+  /* sender -> GSequence of Entry, oldest first */
+  GHashTable *senders;
+};
+
+static gint
+compare_age (gconstpointer a,
+             gconstpointer b,
+             gpointer      user_data)
+{
+  const Entry *entry_a;
+  const Entry *entry_b;
+
+  entry_a = a;
+  entry_b = b;
+
+  if (entry_a->update_time != entry_b->update_time)
+    return entry_a->update_time < entry_b->update_time ? -1 : 1;
+
+  if (entry_a->id != entry_b->id)
+    return entry_a->id < entry_b->id ? -1 : 1;
+
+  return 0;
+}
+
+static gint
+compare_urgency (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      user_data)
+{
+  const Entry *entry_a;
+  const Entry *entry_b;
+
+  entry_a = a;
+  entry_b = b;
+
+  if (entry_a->urgency != entry_b->urgency)
+    return entry_a->urgency < entry_b->urgency ? -1 : 1;
+
+  return compare_age (a, b, user_data);
+}
+
+/* Socket clients have no bus name and share a single group */
+static const gchar *
+get_sender_key (NdNotification *notification)
+{
+  const gchar *sender;
+
+  sender = nd_notification_get_sender (notification);
+
+  return sender != NULL ? sender : "";
+}
+
+static void
+entry_free (gpointer data)
+{
+  Entry *entry;
+
+  entry = data;
+
+  nd_string_pool_release (entry->sender);
+  g_slice_free (Entry, entry);
+}
+
+static void
+unlink_entry (NdEvictionIndex *index,
+              Entry           *entry)
+{
+  GSequence *by_age;
+
+  g_sequence_remove (entry->by_urgency);
+
+  by_age = g_sequence_iter_get_sequence (entry->by_age);
+  g_sequence_remove (entry->by_age);
+
+  if (g_sequence_is_empty (by_age))
+    g_hash_table_remove (index->senders, entry->sender);
+}
+
+NdEvictionIndex *
+nd_eviction_index_new (void)
+{
+  NdEvictionIndex *index;
+
+  index = g_new0 (NdEvictionIndex, 1);
+  index->entries = g_hash_table_new_full (NULL, NULL, NULL, entry_free);
+  index->by_urgency = g_sequence_new (NULL);
+  index->senders = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          (GDestroyNotify) nd_string_pool_release,
+                                          (GDestroyNotify) g_sequence_free);
+
+  return index;
+}
+
+void
+nd_eviction_index_free (NdEvictionIndex *index)
+{
+  g_hash_table_destroy (index->senders);
+  g_sequence_free (index->by_urgency);
+  g_hash_table_destroy (index->entries);
+
+  g_free (index);
+}
+
+/* Adds @notification, or moves it if it is already in the index.
+ * The index does not hold a reference.
+ */
+void
+nd_eviction_index_add (NdEvictionIndex *index,
+                       NdNotification  *notification)
+{
+  Entry *entry;
+  GSequence *by_age;
+  guint id;
+
+  id = nd_notification_get_id (notification);
+  entry = g_hash_table_lookup (index->entries, GUINT_TO_POINTER (id));
+
+  if (entry != NULL)
+    {
+      unlink_entry (index, entry);
+      nd_string_pool_release (entry->sender);
+    }
+  else
+    {
+      entry = g_slice_new0 (Entry);
+      entry->id = id;
+
+      g_hash_table_insert (index->entries, GUINT_TO_POINTER (id), entry);
+    }
+
+  entry->sender = nd_string_pool_intern (get_sender_key (notification));
+  entry->notification = notification;
+  entry->urgency = nd_notification_get_urgency (notification);
+  entry->update_time = nd_notification_get_update_time (notification);
+
+  by_age = g_hash_table_lookup (index->senders, entry->sender);
+  if (by_age == NULL)
+    {
+      by_age = g_sequence_new (NULL);
+      g_hash_table_insert (index->senders,
+                           (gpointer) nd_string_pool_intern (entry->sender),
+                           by_age);
+    }
+
+  entry->by_urgency = g_sequence_insert_sorted (index->by_urgency, entry,
+                                                compare_urgency, NULL);
+  entry->by_age = g_sequence_insert_sorted (by_age, entry, compare_age, NULL);
+}
+
+void
+nd_eviction_index_remove (NdEvictionIndex *index,
+                          NdNotification  *notification)
+{
+  Entry *entry;
+  guint id;
+
+  id = nd_notification_get_id (notification);
+  entry = g_hash_table_lookup (index->entries, GUINT_TO_POINTER (id));
+
+  if (entry == NULL || entry->notification != notification)
+    return;
+
+  unlink_entry (index, entry);
+  g_hash_table_remove (index->entries, GUINT_TO_POINTER (id));
+}
+
+void
+nd_eviction_index_remove_all (NdEvictionIndex *index)
+{
+  g_hash_table_remove_all (index->senders);
+  g_sequence_remove_range (g_sequence_get_begin_iter (index->by_urgency),
+                           g_sequence_get_end_iter (index->by_urgency));
+  g_hash_table_remove_all (index->entries);
+}
+
+/* Returns the oldest notification of the lowest urgency, or NULL. */
+NdNotification *
+nd_eviction_index_get_lowest (NdEvictionIndex *index)
+{
+  GSequenceIter *iter;
+  Entry *entry;
+
+  iter = g_sequence_get_begin_iter (index->by_urgency);
+  if (g_sequence_iter_is_end (iter))
+    return NULL;
+
+  entry = g_sequence_get (iter);
+
+  return entry->notification;
+}
+
+/* Returns the notification after @notification by urgency and age, or
+ * NULL.  Together with nd_eviction_index_get_lowest() this walks the
+ * notifications in the order they are evicted in.
+ */
+NdNotification *
+nd_eviction_index_get_next (NdEvictionIndex *index,
+                            NdNotification  *notification)
+{
+  GSequenceIter *iter;
+  Entry *entry;
+
+  entry = g_hash_table_lookup (index->entries,
+                               GUINT_TO_POINTER (nd_notification_get_id (notification)));
+  if (entry == NULL || entry->notification != notification)
+    return NULL;
+
+  iter = g_sequence_iter_next (entry->by_urgency);
+  if (g_sequence_iter_is_end (iter))
+    return NULL;
+
+  entry = g_sequence_get (iter);
+
+  return entry->notification;
+}
+
+/* Returns the oldest notification posted by @sender, or NULL. */
+NdNotification *
+nd_eviction_index_get_oldest_from (NdEvictionIndex *index,
+                                   const gchar     *sender)
+{
+  GSequence *by_age;
+  Entry *entry;
+
+  by_age = g_hash_table_lookup (index->senders, sender != NULL ? sender : "");
+  if (by_age == NULL)
+    return NULL;
+
+  entry = g_sequence_get (g_sequence_get_begin_iter (by_age));
+
+  return entry->notification;
+}
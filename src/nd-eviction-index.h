@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ND_EVICTION_INDEX_H
+#define ND_EVICTION_INDEX_H
+
+#include "nd-notification.h"
+
+G_BEGIN_DECLS
+
+typedef struct _NdEvictionIndex NdEvictionIndex;
+
+NdEvictionIndex *nd_eviction_index_new              (void);
+void             nd_eviction_index_free             (NdEvictionIndex *index);
+
+void             nd_eviction_index_add              (NdEvictionIndex *index,
+                                                     NdNotification  *notification);
+void             nd_eviction_index_remove           (NdEvictionIndex *index,
+                                                     NdNotification  *notification);
+void             nd_eviction_index_remove_all       (NdEvictionIndex *index);
+
+NdNotification  *nd_eviction_index_get_lowest       (NdEvictionIndex *index);
+NdNotification  *nd_eviction_index_get_next         (NdEvictionIndex *index,
+                                                     NdNotification  *notification);
+NdNotification  *nd_eviction_index_get_oldest_from  (NdEvictionIndex *index,
+                                                     const gchar     *sender);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "nd-id-allocator.h"
+
+/*
+ * Every live id owns the slot at (id & SLOT_MASK), which holds the id
+ * itself while it is in use and 0 once it has been released.  Taking
+ * or giving back a slot is a single compare and exchange, so the
+ * allocator can be used from any thread without a lock, and an id
+ * that wrapped around is skipped for as long as its previous holder
+ * is still alive.
+ *
+ * Ids stay in the positive range of a gint32, since that is how they
+ * are passed around in signals.
+ */
+
+#define N_SLOTS 65536
+#define SLOT_MASK (N_SLOTS - 1)
+
+struct _NdIdAllocator
+{
+  gint cursor;
+  gint n_live;
+  gint slots[N_SLOTS];
+};
+
+static guint32
+next_candidate (NdIdAllocator *allocator,
+                guint          n_ids)
+{
+  guint32 first;
+
+  first = (guint32) g_atomic_int_add (&allocator->cursor, n_ids);
+
+  return first & G_MAXINT32;
+}
+
+NdIdAllocator *
+nd_id_allocator_new (void)
+{
+  NdIdAllocator *allocator;
+
+  allocator = g_new0 (NdIdAllocator, 1);
+  allocator->cursor = 1;
+
+  return allocator;
+}
+
+void
+nd_id_allocator_free (NdIdAllocator *allocator)
+{
+  g_free (allocator);
+}
+
+/* Marks @id as live if its slot is free.  Fails when the slot is
+ * held, including by @id itself.
+ */
+gboolean
+nd_id_allocator_claim (NdIdAllocator *allocator,
+                       guint32        id)
+{
+  gint *slot;
+
+  g_return_val_if_fail (id > 0 && id <= G_MAXINT32, FALSE);
+
+  slot = &allocator->slots[id & SLOT_MASK];
+
+  if (!g_atomic_int_compare_and_exchange (slot, 0, (gint) id))
+    return FALSE;
+
+  g_atomic_int_inc (&allocator->n_live);
+
+  return TRUE;
+}
+
+/* Returns a new live id, or 0 if every slot is taken. */
+guint32
+nd_id_allocator_allocate (NdIdAllocator *allocator)
+{
+  guint attempts;
+
+  for (attempts = 0; attempts < N_SLOTS; attempts++)
+    {
+      guint32 id;
+
+      id = next_candidate (allocator, 1);
+
+      if (id != 0 && nd_id_allocator_claim (allocator, id))
+        return id;
+    }
+
+  return 0;
+}
+
+/* Reserves up to @n_ids ids with a single bump of the shared cursor,
+ * falling back to single allocations for the slots that were taken.
+ * Returns the number of ids stored in @ids.
+ */
+guint
+nd_id_allocator_reserve (NdIdAllocator *allocator,
+                         guint32       *ids,
+                         guint          n_ids)
+{
+  guint32 first;
+  guint n_reserved;
+  guint i;
+
+  if (n_ids == 0)
+    return 0;
+
+  first = next_candidate (allocator, n_ids);
+  n_reserved = 0;
+
+  for (i = 0; i < n_ids; i++)
+    {
+      guint32 id;
+
+      id = (first + i) & G_MAXINT32;
+
+      if (id != 0 && nd_id_allocator_claim (allocator, id))
+        ids[n_reserved++] = id;
+    }
+
+  while (n_reserved < n_ids)
+    {
+      guint32 id;
+
+      id = nd_id_allocator_allocate (allocator);
+      if (id == 0)
+        break;
+
+      ids[n_reserved++] = id;
+    }
+
+  return n_reserved;
+}
+
+void
+nd_id_allocator_release (NdIdAllocator *allocator,
+                         guint32        id)
+{
+  if (id == 0 || id > G_MAXINT32)
+    return;
+
+  if (g_atomic_int_compare_and_exchange (&allocator->slots[id & SLOT_MASK],
+                                         (gint) id, 0))
+    g_atomic_int_add (&allocator->n_live, -1);
+}
+
+gboolean
+nd_id_allocator_is_live (NdIdAllocator *allocator,
+                         guint32        id)
+{
+  if (id == 0 || id > G_MAXINT32)
+    return FALSE;
+
+  return g_atomic_int_get (&allocator->slots[id & SLOT_MASK]) == (gint) id;
+}
+
+guint
+nd_id_allocator_get_n_live (NdIdAllocator *allocator)
+{
+  return g_atomic_int_get (&allocator->n_live);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ND_ID_ALLOCATOR_H
+#define ND_ID_ALLOCATOR_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _NdIdAllocator NdIdAllocator;
+
+NdIdAllocator *nd_id_allocator_new        (void);
+void           nd_id_allocator_free       (NdIdAllocator *allocator);
+
+guint32        nd_id_allocator_allocate   (NdIdAllocator *allocator);
+guint          nd_id_allocator_reserve    (NdIdAllocator *allocator,
+                                           guint32       *ids,
+                                           guint          n_ids);
+
+gboolean       nd_id_allocator_claim      (NdIdAllocator *allocator,
+                                           guint32        id);
+void           nd_id_allocator_release    (NdIdAllocator *allocator,
+                                           guint32        id);
+
+gboolean       nd_id_allocator_is_live    (NdIdAllocator *allocator,
+                                           guint32        id);
+guint          nd_id_allocator_get_n_live (NdIdAllocator *allocator);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "nd-inhibitor.h"
+
+/*
+ * Decides whether notifications should be drawn.  They are not while
+ * a client holds an Inhibit cookie, while the screen saver is active
+ * or while the session is busy or idle.  A cookie goes away when the
+ * client that took it leaves the bus.  ::inhibited-changed is emitted
+ * when the outcome changes.
+ */
+
+#define SCREENSAVER_DBUS_NAME "org.freedesktop.ScreenSaver"
+#define SCREENSAVER_DBUS_PATH "/org/freedesktop/ScreenSaver"
+#define SCREENSAVER_DBUS_IFACE "org.freedesktop.ScreenSaver"
+#define GNOME_SCREENSAVER_DBUS_NAME "org.gnome.ScreenSaver"
+#define GNOME_SCREENSAVER_DBUS_PATH "/org/gnome/ScreenSaver"
+#define GNOME_SCREENSAVER_DBUS_IFACE "org.gnome.ScreenSaver"
+
+#define PRESENCE_DBUS_NAME "org.gnome.SessionManager"
+#define PRESENCE_DBUS_PATH "/org/gnome/SessionManager/Presence"
+#define PRESENCE_DBUS_IFACE "org.gnome.SessionManager.Presence"
+
+typedef enum
+{
+  PRESENCE_AVAILABLE,
+  PRESENCE_INVISIBLE,
+  PRESENCE_BUSY,
+  PRESENCE_IDLE
+} PresenceStatus;
+
+typedef struct
+{
+  NdInhibitor *inhibitor;
+  guint        cookie;
+  gchar       *sender;
+  gchar       *reason;
+  guint        watch_id;
+} Inhibition;
+
+struct _NdInhibitor
+{
+  GObject          parent;
+
+  /* cookie -> Inhibition */
+  GHashTable      *inhibitions;
+
+  GDBusConnection *connection;
+  guint            subscription_ids[3];
+
+  gboolean         screen_locked;
+  gboolean         away;
+
+  gboolean         inhibited;
+};
+
+enum
+{
+  INHIBITED_CHANGED,
+
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (NdInhibitor, nd_inhibitor, G_TYPE_OBJECT)
+
+static void
+inhibition_free (gpointer data)
+{
+  Inhibition *inhibition;
+
+  inhibition = data;
+
+  g_bus_unwatch_name (inhibition->watch_id);
+  g_free (inhibition->sender);
+  g_free (inhibition->reason);
+
+  g_slice_free (Inhibition, inhibition);
+}
+
+static void
+update_inhibited (NdInhibitor *inhibitor)
+{
+  gboolean inhibited;
+
+  inhibited = g_hash_table_size (inhibitor->inhibitions) > 0 ||
+              inhibitor->screen_locked || inhibitor->away;
+
+  if (inhibited == inhibitor->inhibited)
+    return;
+
+  inhibitor->inhibited = inhibited;
+  g_signal_emit (inhibitor, signals[INHIBITED_CHANGED], 0, inhibited);
+}
+
+static void
+set_screen_locked (NdInhibitor *inhibitor,
+                   GVariant    *parameters)
+{
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(b)")))
+    return;
+
+  g_variant_get (parameters, "(b)", &inhibitor->screen_locked);
+  update_inhibited (inhibitor);
+}
+
+static void
+set_presence (NdInhibitor *inhibitor,
+              guint        status)
+{
+  inhibitor->away = status == PRESENCE_BUSY || status == PRESENCE_IDLE;
+  update_inhibited (inhibitor);
+}
+
+static void
+screensaver_active_changed_cb (GDBusConnection *connection,
+                               const gchar     *sender_name,
+                               const gchar     *object_path,
+                               const gchar     *interface_name,
+                               const gchar     *signal_name,
+                               GVariant        *parameters,
+                               gpointer         user_data)
+{
+  set_screen_locked (ND_INHIBITOR (user_data), parameters);
+}
+
+static void
+presence_status_changed_cb (GDBusConnection *connection,
+                            const gchar     *sender_name,
+                            const gchar     *object_path,
+                            const gchar     *interface_name,
+                            const gchar     *signal_name,
+                            GVariant        *parameters,
+                            gpointer         user_data)
+{
+  guint status;
+
+  if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(u)")))
+    return;
+
+  g_variant_get (parameters, "(u)", &status);
+  set_presence (ND_INHIBITOR (user_data), status);
+}
+
+static void
+get_active_cb (GObject      *source,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  NdInhibitor *inhibitor;
+  GVariant *reply;
+
+  inhibitor = ND_INHIBITOR (user_data);
+
+  /* No screen saver, or one that does not implement the interface */
+  reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result,
+                                         NULL);
+
+  if (reply != NULL)
+    {
+      set_screen_locked (inhibitor, reply);
+      g_variant_unref (reply);
+    }
+
+  g_object_unref (inhibitor);
+}
+
+static void
+get_status_cb (GObject      *source,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  NdInhibitor *inhibitor;
+  GVariant *reply;
+  GVariant *status;
+
+  inhibitor = ND_INHIBITOR (user_data);
+
+  reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result,
+                                         NULL);
+
+  if (reply != NULL)
+    {
+      g_variant_get (reply, "(v)", &status);
+
+      if (g_variant_is_of_type (status, G_VARIANT_TYPE_UINT32))
+        set_presence (inhibitor, g_variant_get_uint32 (status));
+
+      g_variant_unref (status);
+      g_variant_unref (reply);
+    }
+
+  g_object_unref (inhibitor);
+}
+
+static void
+name_vanished_cb (GDBusConnection *connection,
+                  const gchar     *name,
+                  gpointer         user_data)
+{
+  Inhibition *inhibition;
+  NdInhibitor *inhibitor;
+
+  inhibition = user_data;
+  inhibitor = inhibition->inhibitor;
+
+  g_debug ("Releasing inhibition %u of %s", inhibition->cookie, name);
+
+  g_hash_table_remove (inhibitor->inhibitions,
+                       GUINT_TO_POINTER (inhibition->cookie));
+  update_inhibited (inhibitor);
+}
+
+static void
+nd_inhibitor_dispose (GObject *object)
+{
+  NdInhibitor *inhibitor;
+  guint i;
+
+  inhibitor = ND_INHIBITOR (object);
+
+  if (inhibitor->connection != NULL)
+    {
+      for (i = 0; i < G_N_ELEMENTS (inhibitor->subscription_ids); i++)
+        g_dbus_connection_signal_unsubscribe (inhibitor->connection,
+                                              inhibitor->subscription_ids[i]);
+
+      g_clear_object (&inhibitor->connection);
+    }
+
+  g_hash_table_remove_all (inhibitor->inhibitions);
+
+  G_OBJECT_CLASS (nd_inhibitor_parent_class)->dispose (object);
+}
+
+static void
+nd_inhibitor_finalize (GObject *object)
+{
+  NdInhibitor *inhibitor;
+
+  inhibitor = ND_INHIBITOR (object);
+
+  g_hash_table_destroy (inhibitor->inhibitions);
+
+  G_OBJECT_CLASS (nd_inhibitor_parent_class)->finalize (object);
+}
+
+static void
+nd_inhibitor_class_init (NdInhibitorClass *inhibitor_class)
+{
+  GObjectClass *object_class;
+
+  object_class = G_OBJECT_CLASS (inhibitor_class);
+
+  object_class->dispose = nd_inhibitor_dispose;
+  object_class->finalize = nd_inhibitor_finalize;
+
+  signals[INHIBITED_CHANGED] =
+    g_signal_new ("inhibited-changed", G_TYPE_FROM_CLASS (inhibitor_class),
+                  G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                  G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+}
+
+static void
+nd_inhibitor_init (NdInhibitor *inhibitor)
+{
+  inhibitor->inhibitions = g_hash_table_new_full (NULL, NULL, NULL,
+                                                  inhibition_free);
+}
+
+NdInhibitor *
+nd_inhibitor_new (void)
+{
+  return g_object_new (ND_TYPE_INHIBITOR, NULL);
+}
+
+/* Starts following the screen saver and the session presence on
+ * @connection.
+ */
+void
+nd_inhibitor_start (NdInhibitor     *inhibitor,
+                    GDBusConnection *connection)
+{
+  g_return_if_fail (ND_IS_INHIBITOR (inhibitor));
+  g_return_if_fail (inhibitor->connection == NULL);
+
+  inhibitor->connection = g_object_ref (connection);
+
+  /* Only from the owners of the screen saver names, so that no other
+   * peer can silence notifications.
+   */
+  inhibitor->subscription_ids[0] =
+    g_dbus_connection_signal_subscribe (connection, SCREENSAVER_DBUS_NAME,
+                                        SCREENSAVER_DBUS_IFACE,
+                                        "ActiveChanged", SCREENSAVER_DBUS_PATH,
+                                        NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+                                        screensaver_active_changed_cb,
+                                        inhibitor, NULL);
+  inhibitor->subscription_ids[1] =
+    g_dbus_connection_signal_subscribe (connection, GNOME_SCREENSAVER_DBUS_NAME,
+                                        GNOME_SCREENSAVER_DBUS_IFACE,
+                                        "ActiveChanged", GNOME_SCREENSAVER_DBUS_PATH,
+                                        NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+                                        screensaver_active_changed_cb,
+                                        inhibitor, NULL);
+  inhibitor->subscription_ids[2] =
+    g_dbus_connection_signal_subscribe (connection, PRESENCE_DBUS_NAME,
+                                        PRESENCE_DBUS_IFACE,
+                                        "StatusChanged", PRESENCE_DBUS_PATH,
+                                        NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+                                        presence_status_changed_cb,
+                                        inhibitor, NULL);
+
+  g_dbus_connection_call (connection, SCREENSAVER_DBUS_NAME,
+                          SCREENSAVER_DBUS_PATH, SCREENSAVER_DBUS_IFACE,
+                          "GetActive", NULL, G_VARIANT_TYPE ("(b)"),
+                          G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, NULL,
+                          get_active_cb, g_object_ref (inhibitor));
+  g_dbus_connection_call (connection, PRESENCE_DBUS_NAME,
+                          PRESENCE_DBUS_PATH,
+                          "org.freedesktop.DBus.Properties", "Get",
+                          g_variant_new ("(ss)", PRESENCE_DBUS_IFACE,
+                                         "status"),
+                          G_VARIANT_TYPE ("(v)"),
+                          G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, NULL,
+                          get_status_cb, g_object_ref (inhibitor));
+}
+
+void
+nd_inhibitor_add (NdInhibitor *inhibitor,
+                  guint        cookie,
+                  const gchar *sender,
+                  const gchar *reason)
+{
+  Inhibition *inhibition;
+
+  g_return_if_fail (ND_IS_INHIBITOR (inhibitor));
+  g_return_if_fail (sender != NULL);
+
+  g_debug ("Inhibited by %s (%s), cookie %u", sender, reason, cookie);
+
+  inhibition = g_slice_new0 (Inhibition);
+  inhibition->inhibitor = inhibitor;
+  inhibition->cookie = cookie;
+  inhibition->sender = g_strdup (sender);
+  inhibition->reason = g_strdup (reason);
+
+  g_hash_table_insert (inhibitor->inhibitions, GUINT_TO_POINTER (cookie),
+                       inhibition);
+
+  /* Also reports a sender that is already gone by now. */
+  inhibition->watch_id = g_bus_watch_name (G_BUS_TYPE_SESSION, sender,
+                                           G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                           NULL, name_vanished_cb,
+                                           inhibition, NULL);
+
+  update_inhibited (inhibitor);
+}
+
+/* Only the client that took @cookie can release it. */
+void
+nd_inhibitor_remove (NdInhibitor *inhibitor,
+                     guint        cookie,
+                     const gchar *sender)
+{
+  Inhibition *inhibition;
+
+  g_return_if_fail (ND_IS_INHIBITOR (inhibitor));
+
+  inhibition = g_hash_table_lookup (inhibitor->inhibitions,
+                                    GUINT_TO_POINTER (cookie));
+
+  if (inhibition == NULL || g_strcmp0 (inhibition->sender, sender) != 0)
+    return;
+
+  g_hash_table_remove (inhibitor->inhibitions, GUINT_TO_POINTER (cookie));
+  update_inhibited (inhibitor);
+}
+
+gboolean
+nd_inhibitor_get_inhibited (NdInhibitor *inhibitor)
+{
+  g_return_val_if_fail (ND_IS_INHIBITOR (inhibitor), FALSE);
+
+  return inhibitor->inhibited;
+}
+
+guint
+nd_inhibitor_get_n_cookies (NdInhibitor *inhibitor)
+{
+  g_return_val_if_fail (ND_IS_INHIBITOR (inhibitor), 0);
+
+  return g_hash_table_size (inhibitor->inhibitions);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ND_INHIBITOR_H
+#define ND_INHIBITOR_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define ND_TYPE_INHIBITOR nd_inhibitor_get_type ()
+G_DECLARE_FINAL_TYPE (NdInhibitor, nd_inhibitor, ND, INHIBITOR, GObject)
+
+NdInhibitor *nd_inhibitor_new           (void);
+
+void         nd_inhibitor_start         (NdInhibitor     *inhibitor,
+                                         GDBusConnection *connection);
+
+void         nd_inhibitor_add           (NdInhibitor     *inhibitor,
+                                         guint            cookie,
+                                         const gchar     *sender,
+                                         const gchar     *reason);
+void         nd_inhibitor_remove        (NdInhibitor     *inhibitor,
+                                         guint            cookie,
+                                         const gchar     *sender);
+
+gboolean     nd_inhibitor_get_inhibited (NdInhibitor     *inhibitor);
+guint        nd_inhibitor_get_n_cookies (NdInhibitor     *inhibitor);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,398 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "nd-action-button.h"
+#include "nd-layout-cache.h"
+
+/* Wrapped text heights of summaries and bodies, so that the stack and
+ * the dock can lay out rows without shaping the same text again.  The
+ * parts of a row that do not depend on the notification are measured
+ * once per theme.
+ */
+
+#define MAX_CACHED_LAYOUTS 256
+
+typedef struct
+{
+        char                 *text;
+        guint                 text_hash;
+        gboolean              markup;
+        PangoFontDescription *font_desc;
+        int                   width;
+} LayoutKey;
+
+typedef struct
+{
+        gboolean valid;
+        int      close_width;
+        int      close_height;
+        int      action_height;
+        int      progress_height;
+} FixedSizes;
+
+static GHashTable *layout_cache = NULL;
+static GtkWidget  *measure_label = NULL;
+static FixedSizes  fixed_sizes = { FALSE, };
+
+static guint
+layout_key_hash (gconstpointer data)
+{
+        const LayoutKey *key = data;
+
+        return key->text_hash
+                ^ pango_font_description_hash (key->font_desc)
+                ^ (guint) key->width
+                ^ (guint) key->markup;
+}
+
+static gboolean
+layout_key_equal (gconstpointer a,
+                  gconstpointer b)
+{
+        const LayoutKey *ka = a;
+        const LayoutKey *kb = b;
+
+        return ka->text_hash == kb->text_hash
+                && ka->markup == kb->markup
+                && ka->width == kb->width
+                && pango_font_description_equal (ka->font_desc, kb->font_desc)
+                && strcmp (ka->text, kb->text) == 0;
+}
+
+static void
+layout_key_free (LayoutKey *key)
+{
+        g_free (key->text);
+        pango_font_description_free (key->font_desc);
+        g_slice_free (LayoutKey, key);
+}
+
+/* Text is measured with the font of @label, or of a label of our
+   own for rows that are not built yet */
+static GtkWidget *
+get_measure_label (GtkWidget *label)
+{
+        if (label != NULL)
+                return label;
+
+        if (measure_label == NULL)
+                measure_label = g_object_ref_sink (gtk_label_new (NULL));
+
+        return measure_label;
+}
+
+static int
+get_height (GtkWidget                  *label,
+            const PangoFontDescription *font_desc,
+            const char                 *source,
+            gboolean                    markup,
+            const char                 *text,
+            PangoAttrList              *attrs,
+            int                         width)
+{
+        LayoutKey    key;
+        LayoutKey   *new_key;
+        PangoLayout *layout;
+        gpointer     value;
+        int          height;
+
+        if (layout_cache == NULL) {
+                layout_cache = g_hash_table_new_full (layout_key_hash,
+                                                      layout_key_equal,
+                                                      (GDestroyNotify) layout_key_free,
+                                                      NULL);
+        }
+
+        key.text = (char *) source;
+        key.text_hash = g_str_hash (source);
+        key.markup = markup;
+        key.font_desc = (PangoFontDescription *) font_desc;
+        key.width = width;
+
+        if (g_hash_table_lookup_extended (layout_cache, &key, NULL, &value))
+                return GPOINTER_TO_INT (value);
+
+        layout = gtk_widget_create_pango_layout (label, NULL);
+        pango_layout_set_font_description (layout, font_desc);
+        pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
+        pango_layout_set_width (layout, width * PANGO_SCALE);
+        pango_layout_set_text (layout, text, -1);
+        pango_layout_set_attributes (layout, attrs);
+        pango_layout_get_pixel_size (layout, NULL, &height);
+        g_object_unref (layout);
+
+        /* Plenty for a stack and a dock; dropping everything keeps
+           this simple and the cache small */
+        if (g_hash_table_size (layout_cache) >= MAX_CACHED_LAYOUTS)
+                g_hash_table_remove_all (layout_cache);
+
+        new_key = g_slice_new (LayoutKey);
+        new_key->text = g_strdup (source);
+        new_key->text_hash = key.text_hash;
+        new_key->markup = markup;
+        new_key->font_desc = pango_font_description_copy (font_desc);
+        new_key->width = width;
+
+        g_hash_table_insert (layout_cache, new_key, GINT_TO_POINTER (height));
+
+        return height;
+}
+
+int
+nd_layout_cache_get_summary_height (NdNotification *notification,
+                                    GtkWidget      *label,
+                                    int             width)
+{
+        PangoContext         *context;
+        PangoFontDescription *font_desc;
+        int                   height;
+
+        g_return_val_if_fail (notification != NULL, 0);
+        g_return_val_if_fail (label == NULL || GTK_IS_WIDGET (label), 0);
+
+        label = get_measure_label (label);
+
+        /* The summary attributes only make the label font bold and
+           large, so fold them into the font and cache on plain text */
+        context = gtk_widget_get_pango_context (label);
+        font_desc = pango_font_description_copy (pango_context_get_font_description (context));
+        pango_font_description_set_weight (font_desc, PANGO_WEIGHT_BOLD);
+        if (pango_font_description_get_size_is_absolute (font_desc)) {
+                pango_font_description_set_absolute_size (font_desc,
+                                                          pango_font_description_get_size (font_desc) * PANGO_SCALE_LARGE);
+        } else {
+                pango_font_description_set_size (font_desc,
+                                                 pango_font_description_get_size (font_desc) * PANGO_SCALE_LARGE);
+        }
+
+        height = get_height (label,
+                             font_desc,
+                             nd_notification_get_summary (notification),
+                             FALSE,
+                             nd_notification_get_summary (notification),
+                             NULL,
+                             width);
+
+        pango_font_description_free (font_desc);
+
+        return height;
+}
+
+int
+nd_layout_cache_get_body_height (NdNotification *notification,
+                                 GtkWidget      *label,
+                                 int             width)
+{
+        PangoContext  *context;
+        PangoAttrList *attrs;
+        const char    *body;
+
+        g_return_val_if_fail (notification != NULL, 0);
+        g_return_val_if_fail (label == NULL || GTK_IS_WIDGET (label), 0);
+
+        body = nd_notification_get_body (notification);
+        if (body == NULL || *body == '\0')
+                return 0;
+
+        label = get_measure_label (label);
+
+        context = gtk_widget_get_pango_context (label);
+        attrs = nd_notification_get_body_attrs (notification);
+
+        /* Keyed on the raw body, so equal text with different markup
+           does not share an entry */
+        return get_height (label,
+                           pango_context_get_font_description (context),
+                           body,
+                           attrs != NULL,
+                           nd_notification_get_body_text (notification),
+                           attrs,
+                           width);
+}
+
+static void
+on_settings_changed (GtkSettings *settings,
+                     GParamSpec  *pspec,
+                     gpointer     user_data)
+{
+        fixed_sizes.valid = FALSE;
+}
+
+static void
+ensure_fixed_sizes (void)
+{
+        static gboolean  watching = FALSE;
+        GtkWidget       *close_button;
+        GtkWidget       *image;
+        GtkWidget       *action_button;
+        GtkWidget       *progress_bar;
+
+        if (fixed_sizes.valid)
+                return;
+
+        if (!watching) {
+                GtkSettings *settings = gtk_settings_get_default ();
+
+                g_signal_connect (settings, "notify::gtk-theme-name",
+                                  G_CALLBACK (on_settings_changed), NULL);
+                g_signal_connect (settings, "notify::gtk-font-name",
+                                  G_CALLBACK (on_settings_changed), NULL);
+                watching = TRUE;
+        }
+
+        /* Built like the close buttons of bubbles and dock rows */
+        close_button = g_object_ref_sink (gtk_button_new ());
+        gtk_button_set_relief (GTK_BUTTON (close_button), GTK_RELIEF_NONE);
+        gtk_container_set_border_width (GTK_CONTAINER (close_button), 0);
+        image = gtk_image_new_from_icon_name ("window-close", GTK_ICON_SIZE_MENU);
+        gtk_widget_show (image);
+        gtk_container_add (GTK_CONTAINER (close_button), image);
+
+        gtk_widget_get_preferred_width (close_button, NULL, &fixed_sizes.close_width);
+        gtk_widget_get_preferred_height (close_button, NULL, &fixed_sizes.close_height);
+
+        action_button = g_object_ref_sink (nd_action_button_new ());
+        nd_action_button_set_action (ND_ACTION_BUTTON (action_button), "ok", "Ok", FALSE);
+        gtk_widget_get_preferred_height (action_button, NULL, &fixed_sizes.action_height);
+
+        progress_bar = g_object_ref_sink (gtk_progress_bar_new ());
+        gtk_widget_get_preferred_height (progress_bar, NULL, &fixed_sizes.progress_height);
+
+        gtk_widget_destroy (close_button);
+        g_object_unref (close_button);
+        gtk_widget_destroy (action_button);
+        g_object_unref (action_button);
+        gtk_widget_destroy (progress_bar);
+        g_object_unref (progress_bar);
+
+        fixed_sizes.valid = TRUE;
+}
+
+int
+nd_layout_cache_get_close_button_width (void)
+{
+        ensure_fixed_sizes ();
+
+        return fixed_sizes.close_width;
+}
+
+int
+nd_layout_cache_get_close_button_height (void)
+{
+        ensure_fixed_sizes ();
+
+        return fixed_sizes.close_height;
+}
+
+/* A row of action buttons with text labels */
+int
+nd_layout_cache_get_action_row_height (void)
+{
+        ensure_fixed_sizes ();
+
+        return fixed_sizes.action_height;
+}
+
+int
+nd_layout_cache_get_progress_height (void)
+{
+        ensure_fixed_sizes ();
+
+        return fixed_sizes.progress_height;
+}
+
+/* The width left to the summary and the body next to the icon and
+   the close button */
+int
+nd_layout_cache_get_text_width (void)
+{
+        return ND_LAYOUT_WIDTH - (1*2) - (ND_LAYOUT_TEXT_BORDER*2)
+                - (ND_LAYOUT_IMAGE_SIZE + 8)
+                - nd_layout_cache_get_close_button_width ()
+                - (ND_LAYOUT_SPACING*2);
+}
+
+static gboolean
+has_image (NdNotification *notification)
+{
+        GHashTable *hints;
+        const char *icon;
+
+        icon = nd_notification_get_icon (notification);
+        if (icon != NULL && *icon != '\0')
+                return TRUE;
+
+        hints = nd_notification_get_hints (notification);
+
+        return g_hash_table_contains (hints, "image-data")
+                || g_hash_table_contains (hints, "image_data")
+                || g_hash_table_contains (hints, "image-path")
+                || g_hash_table_contains (hints, "image_path")
+                || g_hash_table_contains (hints, "icon_data");
+}
+
+/* The height of the icon, text and close button of a bubble or a dock
+ * row for @notification, without the frame around them, from cached
+ * text heights and the fixed parts.  An image counts at its largest
+ * size.
+ */
+int
+nd_layout_cache_get_content_height (NdNotification *notification)
+{
+        int      text_width;
+        int      content;
+        int      height;
+        gboolean image;
+
+        g_return_val_if_fail (notification != NULL, 0);
+
+        text_width = nd_layout_cache_get_text_width ();
+        image = has_image (notification);
+
+        /* body, progress bar and actions, spaced when shown */
+        content = nd_layout_cache_get_body_height (notification, NULL, text_width);
+
+        if (nd_notification_get_value (notification) >= 0) {
+                content += (content > 0 ? ND_LAYOUT_SPACING : 0)
+                        + nd_layout_cache_get_progress_height ();
+        }
+
+        if (nd_action_buttons_count (notification) > 0) {
+                content += (content > 0 ? ND_LAYOUT_SPACING : 0)
+                        + nd_layout_cache_get_action_row_height ();
+        }
+
+        height = (ND_LAYOUT_TEXT_BORDER*2)
+                + nd_layout_cache_get_summary_height (notification, NULL, text_width);
+
+        /* the content row is also shown for the image alone */
+        if (content > 0 || image)
+                height += ND_LAYOUT_SPACING + content;
+
+        if (image)
+                height = MAX (height, ND_LAYOUT_IMAGE_SIZE + ND_LAYOUT_ICON_MARGIN);
+
+        return MAX (height, nd_layout_cache_get_close_button_height ());
+}
@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ND_LAYOUT_CACHE_H
+#define __ND_LAYOUT_CACHE_H
+
+#include <gtk/gtk.h>
+
+#include "nd-notification.h"
+
+G_BEGIN_DECLS
+
+/* Geometry shared by bubbles and dock rows */
+#define ND_LAYOUT_WIDTH         400
+#define ND_LAYOUT_IMAGE_SIZE    48
+#define ND_LAYOUT_TEXT_BORDER   10
+#define ND_LAYOUT_SPACING       6
+#define ND_LAYOUT_ICON_MARGIN   5
+
+int                 nd_layout_cache_get_summary_height      (NdNotification *notification,
+                                                             GtkWidget      *label,
+                                                             int             width);
+int                 nd_layout_cache_get_body_height         (NdNotification *notification,
+                                                             GtkWidget      *label,
+                                                             int             width);
+
+int                 nd_layout_cache_get_close_button_width  (void);
+int                 nd_layout_cache_get_close_button_height (void);
+int                 nd_layout_cache_get_action_row_height   (void);
+int                 nd_layout_cache_get_progress_height     (void);
+
+int                 nd_layout_cache_get_text_width          (void);
+int                 nd_layout_cache_get_content_height      (NdNotification *notification);
+
+G_END_DECLS
+
+#endif /* __ND_LAYOUT_CACHE_H */
@@ -25,6 +25,15 @@
 
 static gboolean debug = FALSE;
 static gboolean replace = FALSE;
+static gint memory_budget = 0;
+static gboolean unicast_signals = FALSE;
+static gchar *orphan_policy = NULL;
+static gboolean animate = FALSE;
+static gboolean single_surface = FALSE;
+static gboolean use_socket = FALSE;
+static gint max_notifications = 20;
+static gchar *overflow_policy = NULL;
+static gint stall_threshold = 0;
 
 static GOptionEntry entries[] =
 {
@@ -40,6 +49,60 @@ static GOptionEntry entries[] =
     N_("Replace a currently running application"),
     NULL
   },
+  {
+    "memory-budget", 0, G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_INT, &memory_budget,
+    N_("Memory budget of stored notifications in KiB, 0 for no limit"),
+    N_("KIB")
+  },
+  {
+    "unicast-signals", 0, G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_NONE, &unicast_signals,
+    N_("Send signals only to the client that posted the notification"),
+    NULL
+  },
+  {
+    "orphan-policy", 0, G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_STRING, &orphan_policy,
+    N_("What to do with notifications of clients that quit: expire, demote or keep"),
+    N_("POLICY")
+  },
+  {
+    "animate", 0, G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_NONE, &animate,
+    N_("Slide and fade bubbles when they are added or removed"),
+    NULL
+  },
+  {
+    "single-surface", 0, G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_NONE, &single_surface,
+    N_("Draw the notifications of a monitor in a single window"),
+    NULL
+  },
+  {
+    "socket", 0, G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_NONE, &use_socket,
+    N_("Also accept notifications on a Unix socket, for bulk producers"),
+    NULL
+  },
+  {
+    "max-notifications", 0, G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_INT, &max_notifications,
+    N_("Number of stored notifications before the overflow policy applies"),
+    N_("N")
+  },
+  {
+    "overflow-policy", 0, G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_STRING, &overflow_policy,
+    N_("What to do once too many notifications are stored: reject, evict-low-urgency, evict-same-sender or collapse"),
+    N_("POLICY")
+  },
+  {
+    "stall-threshold", 0, G_OPTION_FLAG_NONE,
+    G_OPTION_ARG_INT, &stall_threshold,
+    N_("Log a trace when the main loop is stuck for longer than this many ms, 0 to disable"),
+    N_("MS")
+  },
   {
     NULL
   }
@@ -90,6 +153,22 @@ main (int argc, char *argv[])
 
   daemon = nd_daemon_new (replace);
 
+  g_object_set (daemon,
+                "memory-budget", (guint) MAX (memory_budget, 0),
+                "unicast-signals", unicast_signals,
+                "animate", animate,
+                "single-surface", single_surface,
+                "socket", use_socket,
+                "max-notifications", (guint) CLAMP (max_notifications, 1, 16384),
+                "stall-threshold", (guint) MAX (stall_threshold, 0),
+                NULL);
+
+  if (orphan_policy != NULL)
+    g_object_set (daemon, "orphan-policy", orphan_policy, NULL);
+
+  if (overflow_policy != NULL)
+    g_object_set (daemon, "overflow-policy", overflow_policy, NULL);
+
   gtk_main ();
 
   g_object_unref (daemon);
@@ -25,14 +25,15 @@
 #include <glib.h>
 #include <glib/gi18n.h>
 
+#include "nd-action-button.h"
 #include "nd-notification.h"
 #include "nd-notification-box.h"
+#include "nd-layout-cache.h"
 
 #define ND_NOTIFICATION_BOX_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ND_TYPE_NOTIFICATION_BOX, NdNotificationBoxPrivate))
 
-#define IMAGE_SIZE    48
+#define IMAGE_SIZE    ND_LAYOUT_IMAGE_SIZE
 #define BODY_X_OFFSET (IMAGE_SIZE + 8)
-#define WIDTH         400
 
 struct NdNotificationBoxPrivate
 {
@@ -46,7 +47,10 @@ struct NdNotificationBoxPrivate
         GtkWidget      *main_hbox;
         GtkWidget      *content_hbox;
         GtkWidget      *actions_box;
+        GtkWidget      *progress_bar;
         GtkWidget      *last_sep;
+
+        gboolean        have_value;
 };
 
 static void     nd_notification_box_finalize    (GObject                *object);
@@ -96,80 +100,25 @@ on_action_clicked (GtkButton         *button,
                    GdkEventButton    *event,
                    NdNotificationBox *notification_box)
 {
-        const char *key = g_object_get_data (G_OBJECT (button), "_action_key");
+        const char *key = nd_action_button_get_key (ND_ACTION_BUTTON (button));
 
         nd_notification_action_invoked (notification_box->priv->notification,
                                         key);
 }
 
-static GtkWidget *
-create_notification_action (NdNotificationBox *box,
-                            NdNotification    *notification,
-                            const char        *text,
-                            const char        *key)
+static void
+update_progress (NdNotificationBox *notification_box)
 {
-        GtkWidget *button;
-        GtkWidget *hbox;
-        GdkPixbuf *pixbuf;
-        char      *buf;
-
-        button = gtk_button_new ();
-        gtk_widget_show (button);
-        gtk_button_set_relief (GTK_BUTTON (button), GTK_RELIEF_NONE);
-        gtk_container_set_border_width (GTK_CONTAINER (button), 0);
-
-        hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
-        gtk_widget_show (hbox);
-        gtk_container_add (GTK_CONTAINER (button), hbox);
-
-        pixbuf = NULL;
-        /* try to load an icon if requested */
-        if (nd_notification_get_action_icons (box->priv->notification)) {
-                pixbuf = gtk_icon_theme_load_icon (gtk_icon_theme_get_for_screen (gtk_widget_get_screen (GTK_WIDGET (box))),
-                                                   key,
-                                                   20,
-                                                   GTK_ICON_LOOKUP_USE_BUILTIN,
-                                                   NULL);
-        }
+        int value;
 
-        if (pixbuf != NULL) {
-                GtkWidget *image;
-
-                image = gtk_image_new_from_pixbuf (pixbuf);
-                g_object_unref (pixbuf);
-                atk_object_set_name (gtk_widget_get_accessible (GTK_WIDGET (button)),
-                                     text);
-                gtk_widget_show (image);
-                gtk_box_pack_start (GTK_BOX (hbox), image, FALSE, FALSE, 0);
-                gtk_widget_set_halign (image, GTK_ALIGN_CENTER);
-                gtk_widget_set_valign (image, GTK_ALIGN_CENTER);
-        } else {
-                GtkWidget *label;
-
-                label = gtk_label_new (NULL);
-                gtk_widget_show (label);
-                gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 0);
-                gtk_label_set_xalign (GTK_LABEL (label), 0.0);
-                buf = g_strdup_printf ("<small>%s</small>", text);
-                gtk_label_set_markup (GTK_LABEL (label), buf);
-                g_free (buf);
-        }
+        value = nd_notification_get_value (notification_box->priv->notification);
 
-        g_object_set_data_full (G_OBJECT (button),
-                                "_action_key", g_strdup (key), g_free);
-        g_signal_connect (G_OBJECT (button),
-                          "button-release-event",
-                          G_CALLBACK (on_action_clicked),
-                          box);
-        return button;
-}
-
-static void
-remove_item (GtkWidget *item,
-             gpointer   data)
-{
-        gtk_container_remove (GTK_CONTAINER (gtk_widget_get_parent (item)),
-                              item);
+        notification_box->priv->have_value = value >= 0;
+        gtk_widget_set_visible (notification_box->priv->progress_bar, value >= 0);
+        if (value >= 0) {
+                gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (notification_box->priv->progress_bar),
+                                               value / 100.0);
+        }
 }
 
 static void
@@ -180,11 +129,6 @@ update_notification_box (NdNotificationBox *notification_box)
         const char    *body;
         gboolean       have_actions;
         GdkPixbuf     *pixbuf;
-        char         **actions;
-        int            i;
-        char          *str;
-        char          *quoted;
-        GtkRequisition req;
         int            summary_width;
 
         /* Add content */
@@ -203,36 +147,24 @@ update_notification_box (NdNotificationBox *notification_box)
         }
 
         /* summary */
-        quoted = g_markup_escape_text (nd_notification_get_summary (notification_box->priv->notification), -1);
-        str = g_strdup_printf ("<b><big>%s</big></b>", quoted);
-        g_free (quoted);
-
-        gtk_label_set_markup (GTK_LABEL (notification_box->priv->summary_label), str);
-        g_free (str);
+        gtk_label_set_text (GTK_LABEL (notification_box->priv->summary_label),
+                            nd_notification_get_summary (notification_box->priv->notification));
+        gtk_label_set_attributes (GTK_LABEL (notification_box->priv->summary_label),
+                                  nd_notification_get_summary_attrs (notification_box->priv->notification));
 
-        gtk_widget_get_preferred_size (notification_box->priv->close_button, NULL, &req);
-        /* -1: main_vbox border width
-           -10: vbox border width
-           -6: spacing for hbox */
-        summary_width = WIDTH - (1*2) - (10*2) - BODY_X_OFFSET - req.width - (6*2);
+        summary_width = nd_layout_cache_get_text_width ();
 
         gtk_widget_set_size_request (notification_box->priv->summary_label,
                                      summary_width,
                                      -1);
 
         /* body */
-        body = nd_notification_get_body (notification_box->priv->notification);
-        if (pango_parse_markup (body, -1, 0, NULL, NULL, NULL, NULL))
-                gtk_label_set_markup (GTK_LABEL (notification_box->priv->body_label), body);
-        else {
-                gchar *tmp;
-
-                tmp = g_markup_escape_text (body, -1);
-                gtk_label_set_text (GTK_LABEL (notification_box->priv->body_label), body);
-                g_free (tmp);
-        }
+        body = nd_notification_get_body_text (notification_box->priv->notification);
+        gtk_label_set_text (GTK_LABEL (notification_box->priv->body_label), body);
+        gtk_label_set_attributes (GTK_LABEL (notification_box->priv->body_label),
+                                  nd_notification_get_body_attrs (notification_box->priv->notification));
 
-        if (body != NULL && *body != '\0') {
+        if (*body != '\0') {
                 gtk_widget_set_size_request (notification_box->priv->body_label,
                                              summary_width,
                                              -1);
@@ -240,34 +172,15 @@ update_notification_box (NdNotificationBox *notification_box)
         }
 
         /* actions */
-        gtk_container_foreach (GTK_CONTAINER (notification_box->priv->actions_box), remove_item, NULL);
-        actions = nd_notification_get_actions (notification_box->priv->notification);
-        for (i = 0; actions[i] != NULL; i += 2) {
-                char *l = actions[i + 1];
-
-                if (l == NULL) {
-                        g_warning ("Label not found for action %s. "
-                                   "The protocol specifies that a label must "
-                                   "follow an action in the actions array",
-                                   actions[i]);
-
-                        break;
-                }
-
-                if (strcasecmp (actions[i], "default") != 0) {
-                        GtkWidget *button;
-
-                        button = create_notification_action (notification_box,
-                                                             notification_box->priv->notification,
-                                                             l,
-                                                             actions[i]);
-                        gtk_box_pack_start (GTK_BOX (notification_box->priv->actions_box), button, FALSE, FALSE, 0);
-
-                        have_actions = TRUE;
-                }
-        }
+        have_actions = nd_action_buttons_update (GTK_BOX (notification_box->priv->actions_box),
+                                                 notification_box->priv->notification,
+                                                 G_CALLBACK (on_action_clicked),
+                                                 notification_box) > 0;
+
+        /* progress */
+        update_progress (notification_box);
 
-        if (have_icon || have_body || have_actions) {
+        if (have_icon || have_body || have_actions || notification_box->priv->have_value) {
                 gtk_widget_show (notification_box->priv->content_hbox);
         } else {
                 gtk_widget_hide (notification_box->priv->content_hbox);
@@ -283,7 +196,7 @@ nd_notification_box_init (NdNotificationBox *notification_box)
         AtkObject     *atkobj;
 
         notification_box->priv = nd_notification_box_get_instance_private (notification_box);
-        box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, ND_LAYOUT_SPACING);
         gtk_container_add (GTK_CONTAINER (notification_box), box);
         gtk_widget_show (box);
 
@@ -291,7 +204,7 @@ nd_notification_box_init (NdNotificationBox *notification_box)
 
         notification_box->priv->icon = gtk_image_new ();
         gtk_widget_set_valign (notification_box->priv->icon, GTK_ALIGN_START);
-        gtk_widget_set_margin_top (notification_box->priv->icon, 5);
+        gtk_widget_set_margin_top (notification_box->priv->icon, ND_LAYOUT_ICON_MARGIN);
         gtk_widget_set_size_request (notification_box->priv->icon,
                                      BODY_X_OFFSET, -1);
         gtk_widget_show (notification_box->priv->icon);
@@ -301,10 +214,10 @@ nd_notification_box_init (NdNotificationBox *notification_box)
 
         /* Add vbox */
 
-        vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+        vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, ND_LAYOUT_SPACING);
         gtk_widget_show (vbox);
         gtk_box_pack_start (GTK_BOX (box), vbox, TRUE, TRUE, 0);
-        gtk_container_set_border_width (GTK_CONTAINER (vbox), 10);
+        gtk_container_set_border_width (GTK_CONTAINER (vbox), ND_LAYOUT_TEXT_BORDER);
 
         /* Add the close button */
 
@@ -345,11 +258,11 @@ nd_notification_box_init (NdNotificationBox *notification_box)
         atkobj = gtk_widget_get_accessible (notification_box->priv->summary_label);
         atk_object_set_description (atkobj, _("Notification summary text."));
 
-        notification_box->priv->content_hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        notification_box->priv->content_hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, ND_LAYOUT_SPACING);
         gtk_widget_show (notification_box->priv->content_hbox);
         gtk_box_pack_start (GTK_BOX (vbox), notification_box->priv->content_hbox, FALSE, FALSE, 0);
 
-        vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+        vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, ND_LAYOUT_SPACING);
 
         gtk_widget_show (vbox);
         gtk_box_pack_start (GTK_BOX (notification_box->priv->content_hbox), vbox, TRUE, TRUE, 0);
@@ -365,20 +278,33 @@ nd_notification_box_init (NdNotificationBox *notification_box)
         atkobj = gtk_widget_get_accessible (notification_box->priv->body_label);
         atk_object_set_description (atkobj, _("Notification body text."));
 
-        notification_box->priv->actions_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        notification_box->priv->actions_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, ND_LAYOUT_SPACING);
         gtk_widget_set_halign (notification_box->priv->actions_box, GTK_ALIGN_END);
         gtk_widget_show (notification_box->priv->actions_box);
 
         gtk_box_pack_start (GTK_BOX (vbox), notification_box->priv->actions_box, FALSE, TRUE, 0);
+
+        notification_box->priv->progress_bar = gtk_progress_bar_new ();
+        gtk_box_pack_start (GTK_BOX (vbox), notification_box->priv->progress_bar, FALSE, TRUE, 0);
+        gtk_box_reorder_child (GTK_BOX (vbox), notification_box->priv->progress_bar, 1);
 }
 
 static void
-on_notification_changed (NdNotification    *notification,
+on_notification_changed (GObject           *binding,
                          NdNotificationBox *notification_box)
 {
         update_notification_box (notification_box);
 }
 
+/* Only the fraction changes; the progress bar queues a single
+   redraw for the next frame however often this runs */
+static void
+on_notification_value_changed (GObject           *binding,
+                               NdNotificationBox *notification_box)
+{
+        update_progress (notification_box);
+}
+
 static void
 nd_notification_box_finalize (GObject *object)
 {
@@ -391,23 +317,36 @@ nd_notification_box_finalize (GObject *object)
 
         g_return_if_fail (notification_box->priv != NULL);
 
-        g_signal_handlers_disconnect_by_func (notification_box->priv->notification, G_CALLBACK (on_notification_changed), notification_box);
-
-        g_object_unref (notification_box->priv->notification);
+        nd_notification_unbind (notification_box->priv->notification, notification_box);
+        nd_notification_unref (notification_box->priv->notification);
 
         G_OBJECT_CLASS (nd_notification_box_parent_class)->finalize (object);
 }
 
+/* The height of a box for @notification, so that rows can be laid out
+ * without a size negotiation or even before they are built.
+ */
+int
+nd_notification_box_estimate_height (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, 0);
+
+        return nd_layout_cache_get_content_height (notification);
+}
+
 NdNotificationBox *
 nd_notification_box_new_for_notification (NdNotification *notification)
 {
         NdNotificationBox *notification_box;
+        GObject           *binding;
 
         notification_box = g_object_new (ND_TYPE_NOTIFICATION_BOX,
                                          "visible-window", FALSE,
                                          NULL);
-        notification_box->priv->notification = g_object_ref (notification);
-        g_signal_connect (notification, "changed", G_CALLBACK (on_notification_changed), notification_box);
+        notification_box->priv->notification = nd_notification_ref (notification);
+        binding = nd_notification_bind (notification);
+        g_signal_connect (binding, "changed", G_CALLBACK (on_notification_changed), notification_box);
+        g_signal_connect (binding, "value-changed", G_CALLBACK (on_notification_value_changed), notification_box);
         update_notification_box (notification_box);
 
         return notification_box;
@@ -52,6 +52,7 @@ GType               nd_notification_box_get_type             (void);
 NdNotificationBox * nd_notification_box_new_for_notification (NdNotification    *notification);
 
 NdNotification *    nd_notification_box_get_notification     (NdNotificationBox *notification_box);
+int                 nd_notification_box_estimate_height      (NdNotification    *notification);
 
 G_END_DECLS
 
@@ -19,73 +19,177 @@
 
 #include "config.h"
 
+#include <fcntl.h>
+#include <math.h>
 #include <string.h>
 #include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib/gi18n.h>
 #include <gtk/gtk.h>
 
 #include "nd-notification.h"
+#include "nd-string-pool.h"
 
-#define ND_NOTIFICATION_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass), ND_TYPE_NOTIFICATION, NdNotificationClass))
-#define ND_IS_NOTIFICATION_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), ND_TYPE_NOTIFICATION))
-#define ND_NOTIFICATION_GET_CLASS(object) (G_TYPE_INSTANCE_GET_CLASS ((object), ND_TYPE_NOTIFICATION, NdNotificationClass))
+/* Size of the icon in the bubble and the dock, decoded when raw
+   image data is dropped to save memory */
+#define COMPACT_IMAGE_SIZE 48
+
+/* Hints smaller than this are copied out of the D-Bus message, so
+   that they don't keep the whole message alive */
+#define MAX_SHARED_HINT_SIZE 4096
 
 enum {
         CHANGED,
+        VALUE_CHANGED,
         CLOSED,
         ACTION_INVOKED,
         LAST_SIGNAL
 };
 
+/* Hints the daemon acts on, parsed once per update */
+typedef struct
+{
+        NdNotificationUrgency urgency;
+        gboolean              resident;
+        gboolean              transient;
+        gboolean              action_icons;
+        int                   value;
+} TypedHints;
+
+/* A plain record rather than a GObject, as most notifications are only
+ * stored and never shown again.  Signals are emitted on the binding,
+ * which only exists while a bubble or a dock row shows the notification.
+ */
 struct _NdNotification {
-        GObject       parent;
+        gint          ref_count;
+
+        /* Weak, set while bound */
+        GObject      *binding;
 
         gboolean      is_queued;
         gboolean      is_closed;
 
         gint64     update_time;
 
-        char         *sender;
+        /* From the string pool, as are the action keys */
+        const char   *sender;
+        const char   *app_name;
+        const char   *icon;
+
         guint32       id;
-        char         *app_name;
-        char         *icon;
+
+        /* Point into a single block, which holds the actions vector
+           followed by the action labels, the summary and the body */
         char         *summary;
         char         *body;
         char        **actions;
+        gsize         strings_size;
+
+        /* Shared with the caller of nd_notification_update(), NULL
+           until the first update */
         GHashTable   *hints;
+        TypedHints    typed_hints;
         int           timeout;
-};
 
-static void nd_notification_finalize     (GObject      *object);
+        /* Earlier notifications of the same sender folded into this one */
+        guint         n_collapsed;
 
-static guint signals[LAST_SIGNAL] = { 0 };
+        /* Parsed summary and body, shared by the bubble and the dock */
+        gboolean       text_parsed;
+        PangoAttrList *summary_attrs;
+        char          *body_text;
+        PangoAttrList *body_attrs;
 
-G_DEFINE_TYPE (NdNotification, nd_notification, G_TYPE_OBJECT)
+        /* Last image loaded by nd_notification_load_image() */
+        GdkPixbuf     *image;
+        int            image_size;
+};
 
-static guint32 notification_serial = 1;
+typedef struct
+{
+        GObject parent;
+} NdNotificationBinding;
 
-static guint32
-get_next_notification_serial (void)
+typedef struct
 {
-        guint32 serial;
+        GObjectClass parent_class;
+} NdNotificationBindingClass;
 
-        serial = notification_serial++;
+typedef struct
+{
+        const NdNotificationObserver *observer;
+        gpointer                      user_data;
+} Observer;
 
-        if ((gint32)notification_serial < 0) {
-                notification_serial = 1;
-        }
+static guint signals[LAST_SIGNAL] = { 0 };
+
+static GSList *observers = NULL;
 
-        return serial;
+G_DEFINE_BOXED_TYPE (NdNotification, nd_notification, nd_notification_ref, nd_notification_unref)
+
+G_DEFINE_TYPE (NdNotificationBinding, nd_notification_binding, G_TYPE_OBJECT)
+
+static void
+clear_parsed_text (NdNotification *notification)
+{
+        notification->text_parsed = FALSE;
+
+        g_clear_pointer (&notification->summary_attrs, pango_attr_list_unref);
+        g_clear_pointer (&notification->body_text, g_free);
+        g_clear_pointer (&notification->body_attrs, pango_attr_list_unref);
 }
 
 static void
-nd_notification_class_init (NdNotificationClass *class)
+ensure_parsed_text (NdNotification *notification)
 {
-        GObjectClass *gobject_class;
+        if (notification->text_parsed)
+                return;
+
+        notification->text_parsed = TRUE;
+
+        /* Same as "<b><big>%s</big></b>" with the escaped summary,
+           without building and parsing the markup */
+        notification->summary_attrs = pango_attr_list_new ();
+        pango_attr_list_insert (notification->summary_attrs,
+                                pango_attr_weight_new (PANGO_WEIGHT_BOLD));
+        pango_attr_list_insert (notification->summary_attrs,
+                                pango_attr_scale_new (PANGO_SCALE_LARGE));
+
+        if (notification->body == NULL
+            || !pango_parse_markup (notification->body, -1, 0,
+                                    &notification->body_attrs,
+                                    &notification->body_text,
+                                    NULL, NULL)) {
+                /* Invalid markup is shown as plain text */
+                notification->body_attrs = NULL;
+                notification->body_text = g_strdup (notification->body != NULL ? notification->body : "");
+        }
+
+        if (notification->n_collapsed > 0) {
+                char *line;
+                char *text;
+
+                line = g_strdup_printf (ngettext ("%u earlier notification",
+                                                  "%u earlier notifications",
+                                                  notification->n_collapsed),
+                                        notification->n_collapsed);
 
-        gobject_class = G_OBJECT_CLASS (class);
+                if (notification->body_text[0] != '\0')
+                        text = g_strconcat (notification->body_text, "\n", line, NULL);
+                else
+                        text = g_strdup (line);
 
-        gobject_class->finalize = nd_notification_finalize;
+                g_free (notification->body_text);
+                notification->body_text = text;
+                g_free (line);
+        }
+}
 
+static void
+nd_notification_binding_class_init (NdNotificationBindingClass *class)
+{
         signals [CHANGED] =
                 g_signal_new ("changed",
                               G_TYPE_FROM_CLASS (class),
@@ -94,6 +198,16 @@ nd_notification_class_init (NdNotificationClass *class)
                               NULL, NULL,
                               g_cclosure_marshal_VOID__VOID,
                               G_TYPE_NONE, 0);
+        /* Emitted instead of ::changed when an update only changed
+           the progress value */
+        signals [VALUE_CHANGED] =
+                g_signal_new ("value-changed",
+                              G_TYPE_FROM_CLASS (class),
+                              G_SIGNAL_RUN_LAST,
+                              0,
+                              NULL, NULL,
+                              g_cclosure_marshal_VOID__VOID,
+                              G_TYPE_NONE, 0);
         signals [CLOSED] =
                 g_signal_new ("closed",
                               G_TYPE_FROM_CLASS (class),
@@ -113,74 +227,513 @@ nd_notification_class_init (NdNotificationClass *class)
 }
 
 static void
-nd_notification_init (NdNotification *notification)
+nd_notification_binding_init (NdNotificationBinding *binding)
+{
+}
+
+/* Tells the observers, then the handlers of the binding if there is
+ * one.  @reason and @action are only used by ::closed and
+ * ::action-invoked.
+ */
+static void
+emit_signal (NdNotification *notification,
+             guint           signal,
+             int             reason,
+             const char     *action)
+{
+        GSList *l;
+        GSList *next;
+
+        nd_notification_ref (notification);
+
+        for (l = observers; l != NULL; l = next) {
+                Observer *o = l->data;
+
+                next = l->next;
+
+                switch (signal) {
+                case CHANGED:
+                        if (o->observer->changed != NULL)
+                                o->observer->changed (notification, o->user_data);
+                        break;
+                case VALUE_CHANGED:
+                        if (o->observer->value_changed != NULL)
+                                o->observer->value_changed (notification, o->user_data);
+                        break;
+                case CLOSED:
+                        if (o->observer->closed != NULL)
+                                o->observer->closed (notification, reason, o->user_data);
+                        break;
+                case ACTION_INVOKED:
+                        if (o->observer->action_invoked != NULL)
+                                o->observer->action_invoked (notification, action, o->user_data);
+                        break;
+                default:
+                        g_assert_not_reached ();
+                }
+        }
+
+        if (notification->binding != NULL) {
+                switch (signal) {
+                case CLOSED:
+                        g_signal_emit (notification->binding, signals[CLOSED], 0, reason);
+                        break;
+                case ACTION_INVOKED:
+                        g_signal_emit (notification->binding, signals[ACTION_INVOKED], 0, action);
+                        break;
+                default:
+                        g_signal_emit (notification->binding, signals[signal], 0);
+                        break;
+                }
+        }
+
+        nd_notification_unref (notification);
+}
+
+/* Adds callbacks that are run for every notification, as the daemon
+ * and the queue care about all of them and would otherwise connect to
+ * each one.
+ */
+void
+nd_notification_add_observer (const NdNotificationObserver *observer,
+                              gpointer                      user_data)
 {
-        notification->id = get_next_notification_serial ();
+        Observer *o;
 
-        notification->app_name = NULL;
-        notification->icon = NULL;
-        notification->summary = NULL;
-        notification->body = NULL;
-        notification->actions = NULL;
-        notification->hints = g_hash_table_new_full (g_str_hash,
-                                                     g_str_equal,
-                                                     g_free,
-                                                     (GDestroyNotify) g_variant_unref);
+        g_return_if_fail (observer != NULL);
+
+        o = g_slice_new (Observer);
+        o->observer = observer;
+        o->user_data = user_data;
+
+        observers = g_slist_append (observers, o);
+}
+
+void
+nd_notification_remove_observer (const NdNotificationObserver *observer,
+                                 gpointer                      user_data)
+{
+        GSList *l;
+
+        for (l = observers; l != NULL; l = l->next) {
+                Observer *o = l->data;
+
+                if (o->observer == observer && o->user_data == user_data) {
+                        observers = g_slist_delete_link (observers, l);
+                        g_slice_free (Observer, o);
+                        return;
+                }
+        }
+}
+
+static gsize
+string_size (const char *str)
+{
+        return str != NULL ? strlen (str) + 1 : 0;
 }
 
 static void
-nd_notification_finalize (GObject *object)
+release_strings (const char  *app_name,
+                 const char  *icon,
+                 char       **actions)
 {
-        NdNotification *notification;
+        int i;
 
-        notification = ND_NOTIFICATION (object);
+        nd_string_pool_release (app_name);
+        nd_string_pool_release (icon);
 
-        g_free (notification->sender);
-        g_free (notification->app_name);
-        g_free (notification->icon);
-        g_free (notification->summary);
-        g_free (notification->body);
-        g_strfreev (notification->actions);
+        /* Only the keys are pooled, the labels are packed */
+        if (actions != NULL) {
+                for (i = 0; actions[i] != NULL; i += 2) {
+                        nd_string_pool_release (actions[i]);
 
-        if (notification->hints != NULL) {
-                g_hash_table_destroy (notification->hints);
+                        if (actions[i + 1] == NULL)
+                                break;
+                }
         }
 
-        if (G_OBJECT_CLASS (nd_notification_parent_class)->finalize)
-                (*G_OBJECT_CLASS (nd_notification_parent_class)->finalize) (object);
+        g_free (actions);
 }
 
-gboolean
-nd_notification_update (NdNotification     *notification,
-                        const gchar        *app_name,
-                        const gchar        *icon,
-                        const gchar        *summary,
-                        const gchar        *body,
-                        const gchar *const *actions,
-                        GVariant           *hints,
-                        gint                timeout)
+static GVariant *
+detach_hint (GVariant *value)
 {
-        GVariant *item;
-        GVariantIter iter;
+        GBytes   *bytes;
+        GVariant *copy;
 
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), FALSE);
+        if (g_variant_get_size (value) > MAX_SHARED_HINT_SIZE)
+                return value;
 
-        g_free (notification->app_name);
-        notification->app_name = g_strdup (app_name);
+        bytes = g_bytes_new (g_variant_get_data (value),
+                             g_variant_get_size (value));
+        copy = g_variant_new_from_bytes (g_variant_get_type (value),
+                                         bytes,
+                                         TRUE);
+        g_bytes_unref (bytes);
+        g_variant_unref (value);
 
-        g_free (notification->icon);
-        notification->icon = g_strdup (icon);
+        return g_variant_ref_sink (copy);
+}
 
-        g_free (notification->summary);
-        notification->summary = g_strdup (summary);
+#ifdef F_GET_SEALS
+typedef struct
+{
+        gpointer data;
+        gsize    size;
+} ImageMapping;
 
-        g_free (notification->body);
-        notification->body = g_strdup (body);
+static void
+image_mapping_free (ImageMapping *mapping)
+{
+        munmap (mapping->data, mapping->size);
+        g_slice_free (ImageMapping, mapping);
+}
+#endif
 
-        g_strfreev (notification->actions);
-        notification->actions = g_strdupv ((char **)actions);
+/* Maps the memfd of an image fd hint read-only and wraps the mapping
+ * as an image-data hint, so the pixels are never copied.  The memfd
+ * has to be sealed against writes and shrinking, so that the sender
+ * cannot change the pixels or fault the daemon once it is mapped.
+ */
+static GVariant *
+map_image_fd (GVariant    *value,
+              GUnixFDList *fd_list)
+{
+#ifdef F_GET_SEALS
+        ImageMapping *mapping;
+        GBytes       *bytes;
+        GVariant     *pixels;
+        struct stat   st;
+        gint32        handle;
+        int           width;
+        int           height;
+        int           rowstride;
+        int           format;
+        int           n_channels;
+        gsize         expected_len;
+        int           seals;
+        int           fd;
+        GError       *error;
+
+        if (fd_list == NULL || !g_variant_is_of_type (value, G_VARIANT_TYPE ("(hiiii)")))
+                return NULL;
+
+        g_variant_get (value, "(hiiii)", &handle, &width, &height, &rowstride, &format);
+
+        switch (format) {
+        case ND_NOTIFICATION_IMAGE_FORMAT_RGB24:
+                n_channels = 3;
+                break;
+        case ND_NOTIFICATION_IMAGE_FORMAT_RGBA32:
+                n_channels = 4;
+                break;
+        default:
+                return NULL;
+        }
 
-        g_hash_table_remove_all (notification->hints);
+        if (width <= 0 || height <= 0 || width > G_MAXINT / n_channels
+            || rowstride < width * n_channels)
+                return NULL;
+
+        expected_len = (gsize) (height - 1) * rowstride + (gsize) width * n_channels;
+
+        if (handle < 0 || handle >= g_unix_fd_list_get_length (fd_list)) {
+                g_warning ("Ignoring " ND_NOTIFICATION_IMAGE_FD_HINT " hint with invalid handle %d",
+                           handle);
+                return NULL;
+        }
+
+        error = NULL;
+        fd = g_unix_fd_list_get (fd_list, handle, &error);
+        if (fd < 0) {
+                g_warning ("Ignoring " ND_NOTIFICATION_IMAGE_FD_HINT " hint: %s",
+                           error->message);
+                g_error_free (error);
+                return NULL;
+        }
+
+        seals = fcntl (fd, F_GET_SEALS);
+        if (seals < 0
+            || (seals & (F_SEAL_WRITE | F_SEAL_SHRINK)) != (F_SEAL_WRITE | F_SEAL_SHRINK)
+            || fstat (fd, &st) < 0
+            || (guint64) st.st_size < expected_len) {
+                g_warning ("Ignoring unsealed or truncated " ND_NOTIFICATION_IMAGE_FD_HINT " hint");
+                close (fd);
+                return NULL;
+        }
+
+        mapping = g_slice_new (ImageMapping);
+        mapping->size = expected_len;
+        mapping->data = mmap (NULL, expected_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close (fd);
+
+        if (mapping->data == MAP_FAILED) {
+                g_slice_free (ImageMapping, mapping);
+                return NULL;
+        }
+
+        bytes = g_bytes_new_with_free_func (mapping->data,
+                                            mapping->size,
+                                            (GDestroyNotify) image_mapping_free,
+                                            mapping);
+        pixels = g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, bytes, TRUE);
+        g_bytes_unref (bytes);
+
+        return g_variant_ref_sink (g_variant_new ("(iiibii@ay)",
+                                                  width,
+                                                  height,
+                                                  rowstride,
+                                                  n_channels == 4,
+                                                  8,
+                                                  n_channels,
+                                                  pixels));
+#else
+        return NULL;
+#endif
+}
+
+static gboolean
+variant_to_boolean (GVariant *value)
+{
+        if (value == NULL)
+                return FALSE;
+
+        if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT32)) {
+                return (g_variant_get_int32 (value) != 0);
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_DOUBLE)) {
+                return (g_variant_get_double (value) != 0);
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING)) {
+                return TRUE;
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_BYTE)) {
+                return (g_variant_get_byte (value) != 0);
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN)) {
+                return g_variant_get_boolean (value);
+        }
+
+        return FALSE;
+}
+
+/* The de-facto "value" hint, a percentage, or -1 without one */
+static int
+variant_to_value (GVariant *value)
+{
+        gint64 percent;
+
+        if (value == NULL)
+                return -1;
+
+        if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT32)) {
+                percent = g_variant_get_int32 (value);
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32)) {
+                percent = g_variant_get_uint32 (value);
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_BYTE)) {
+                percent = g_variant_get_byte (value);
+        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_DOUBLE)) {
+                gdouble d = g_variant_get_double (value);
+
+                /* Converting NaN or a double out of range is undefined */
+                if (isnan (d))
+                        return -1;
+
+                percent = (gint64) CLAMP (d, 0.0, 100.0);
+        } else {
+                return -1;
+        }
+
+        return CLAMP (percent, 0, 100);
+}
+
+static void
+parse_typed_hints (GHashTable *hints,
+                   TypedHints *typed)
+{
+        GVariant *value;
+
+        typed->resident = variant_to_boolean (g_hash_table_lookup (hints, "resident"));
+        typed->transient = variant_to_boolean (g_hash_table_lookup (hints, "transient"));
+        typed->action_icons = variant_to_boolean (g_hash_table_lookup (hints, "action-icons"));
+        typed->value = variant_to_value (g_hash_table_lookup (hints, "value"));
+
+        typed->urgency = ND_NOTIFICATION_URGENCY_NORMAL;
+        value = g_hash_table_lookup (hints, "urgency");
+        if (value != NULL && g_variant_is_of_type (value, G_VARIANT_TYPE_BYTE)) {
+                typed->urgency = MIN (g_variant_get_byte (value), ND_NOTIFICATION_URGENCY_CRITICAL);
+        }
+}
+
+static char *
+pack_string (char       **p,
+             const char  *str)
+{
+        char  *packed;
+        gsize  size;
+
+        if (str == NULL)
+                return NULL;
+
+        size = strlen (str) + 1;
+        packed = memcpy (*p, str, size);
+        *p += size;
+
+        return packed;
+}
+
+/* Copies the strings of an update into one allocation, instead of one
+ * for each of them.  The identifiers, which repeat across notifications,
+ * are taken from the pool instead: the application name, the icon and
+ * the action keys.  Action labels are free-form and packed.
+ */
+static void
+pack_strings (NdNotification     *notification,
+              const gchar        *app_name,
+              const gchar        *icon,
+              const gchar        *summary,
+              const gchar        *body,
+              const gchar *const *actions)
+{
+        const char *old_app_name;
+        const char *old_icon;
+        char      **old_actions;
+        char      **vector;
+        char       *p;
+        gsize       n_actions;
+        gsize       size;
+        gsize       i;
+
+        n_actions = actions != NULL ? g_strv_length ((gchar **) actions) : 0;
+
+        size = (n_actions + 1) * sizeof (char *);
+        for (i = 1; i < n_actions; i += 2) {
+                size += string_size (actions[i]);
+        }
+        size += string_size (summary);
+        size += string_size (body);
+
+        vector = g_malloc (size);
+        p = (char *) (vector + n_actions + 1);
+
+        for (i = 0; i < n_actions; i++) {
+                if (i % 2 == 0)
+                        vector[i] = (char *) nd_string_pool_intern (actions[i]);
+                else
+                        vector[i] = pack_string (&p, actions[i]);
+        }
+        vector[n_actions] = NULL;
+
+        /* The arguments may point into the current strings, which are
+           only given back once everything has been copied */
+        old_app_name = notification->app_name;
+        old_icon = notification->icon;
+        old_actions = notification->actions;
+
+        notification->app_name = nd_string_pool_intern (app_name);
+        notification->icon = nd_string_pool_intern (icon);
+        notification->summary = pack_string (&p, summary);
+        notification->body = pack_string (&p, body);
+        notification->actions = vector;
+        notification->strings_size = size;
+
+        release_strings (old_app_name, old_icon, old_actions);
+}
+
+static gboolean
+strv_equal (char              **a,
+            const gchar *const *b)
+{
+        int i;
+
+        if (a == NULL || b == NULL)
+                return (a == NULL || a[0] == NULL) && (b == NULL || b[0] == NULL);
+
+        for (i = 0; a[i] != NULL && b[i] != NULL; i++) {
+                if (strcmp (a[i], b[i]) != 0)
+                        return FALSE;
+        }
+
+        return a[i] == NULL && b[i] == NULL;
+}
+
+static gboolean
+hints_equal_but_value (GHashTable *a,
+                       GHashTable *b)
+{
+        GHashTableIter iter;
+        gpointer       key, value;
+        guint          size_a, size_b;
+
+        size_a = g_hash_table_size (a) - (g_hash_table_contains (a, "value") ? 1 : 0);
+        size_b = g_hash_table_size (b) - (g_hash_table_contains (b, "value") ? 1 : 0);
+
+        if (size_a != size_b)
+                return FALSE;
+
+        g_hash_table_iter_init (&iter, b);
+        while (g_hash_table_iter_next (&iter, &key, &value)) {
+                GVariant *other;
+
+                if (strcmp (key, "value") == 0)
+                        continue;
+
+                other = g_hash_table_lookup (a, key);
+                if (other == NULL || !g_variant_equal (other, value))
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+/* Whether an update would only change the progress value, which is
+ * what most rapid replacements of a notification do.
+ */
+static gboolean
+is_value_update (NdNotification     *notification,
+                 const gchar        *app_name,
+                 const gchar        *icon,
+                 const gchar        *summary,
+                 const gchar        *body,
+                 const gchar *const *actions,
+                 GHashTable         *hints,
+                 gint                timeout)
+{
+        if (notification->typed_hints.value < 0
+            || !g_hash_table_contains (hints, "value"))
+                return FALSE;
+
+        return timeout == notification->timeout
+                && g_strcmp0 (app_name, notification->app_name) == 0
+                && g_strcmp0 (icon, notification->icon) == 0
+                && g_strcmp0 (summary, notification->summary) == 0
+                && g_strcmp0 (body, notification->body) == 0
+                && strv_equal (notification->actions, actions)
+                && hints_equal_but_value (notification->hints, hints);
+}
+
+/* A hints table, whose keys are taken from the string pool */
+GHashTable *
+nd_notification_hints_new (void)
+{
+        return g_hash_table_new_full (g_str_hash,
+                                      g_str_equal,
+                                      (GDestroyNotify) nd_string_pool_release,
+                                      (GDestroyNotify) g_variant_unref);
+}
+
+/* Walks the a{sv} hints of a Notify call into a table suitable for
+ * nd_notification_update().  Does not touch any notification, so it
+ * can run on the D-Bus dispatch thread.  @fd_list holds the file
+ * descriptors sent with the call, if any; an image fd hint is turned
+ * into image-data backed by the mapped fd.
+ */
+GHashTable *
+nd_notification_parse_hints (GVariant    *hints,
+                             GUnixFDList *fd_list)
+{
+        GHashTable  *table;
+        GVariant    *item;
+        GVariant    *image_fd;
+        GVariantIter iter;
+
+        table = nd_notification_hints_new ();
 
         g_variant_iter_init (&iter, hints);
         while ((item = g_variant_iter_next_value (&iter))) {
@@ -188,20 +741,70 @@ nd_notification_update (NdNotification     *notification,
                 GVariant   *value;
 
                 g_variant_get (item,
-                               "{sv}",
+                               "{&sv}",
                                &key,
                                &value);
 
-                g_hash_table_insert (notification->hints,
-                                     g_strdup (key),
-                                     value); /* steals value */
+                g_hash_table_insert (table,
+                                     (gpointer) nd_string_pool_intern (key),
+                                     detach_hint (value));
+                g_variant_unref (item);
         }
 
-        notification->timeout = timeout;
+        image_fd = g_hash_table_lookup (table, ND_NOTIFICATION_IMAGE_FD_HINT);
+        if (image_fd != NULL) {
+                GVariant *image_data;
+
+                image_data = map_image_fd (image_fd, fd_list);
+                g_hash_table_remove (table, ND_NOTIFICATION_IMAGE_FD_HINT);
+
+                if (image_data != NULL) {
+                        g_hash_table_insert (table,
+                                             (gpointer) nd_string_pool_intern ("image-data"),
+                                             image_data);
+                }
+        }
+
+        return table;
+}
 
-        g_signal_emit (notification, signals[CHANGED], 0);
+gboolean
+nd_notification_update (NdNotification     *notification,
+                        const gchar        *app_name,
+                        const gchar        *icon,
+                        const gchar        *summary,
+                        const gchar        *body,
+                        const gchar *const *actions,
+                        GHashTable         *hints,
+                        gint                timeout)
+{
+        g_return_val_if_fail (notification != NULL, FALSE);
 
-        notification->update_time = g_get_real_time();
+        if (is_value_update (notification, app_name, icon, summary, body,
+                             actions, hints, timeout)) {
+                g_hash_table_unref (notification->hints);
+                notification->hints = g_hash_table_ref (hints);
+                notification->typed_hints.value = variant_to_value (g_hash_table_lookup (hints, "value"));
+                notification->update_time = g_get_real_time ();
+
+                emit_signal (notification, VALUE_CHANGED, 0, NULL);
+
+                return TRUE;
+        }
+
+        pack_strings (notification, app_name, icon, summary, body, actions);
+        clear_parsed_text (notification);
+
+        if (notification->hints != NULL)
+                g_hash_table_unref (notification->hints);
+        notification->hints = g_hash_table_ref (hints);
+        parse_typed_hints (notification->hints, &notification->typed_hints);
+        g_clear_object (&notification->image);
+
+        notification->timeout = timeout;
+        notification->update_time = g_get_real_time ();
+
+        emit_signal (notification, CHANGED, 0, NULL);
 
         return TRUE;
 }
@@ -210,7 +813,7 @@ void
 nd_notification_set_is_queued (NdNotification *notification,
                                gboolean        is_queued)
 {
-        g_return_if_fail (ND_IS_NOTIFICATION (notification));
+        g_return_if_fail (notification != NULL);
 
         notification->is_queued = is_queued;
 }
@@ -218,7 +821,7 @@ nd_notification_set_is_queued (NdNotification *notification,
 gboolean
 nd_notification_get_is_queued (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), FALSE);
+        g_return_val_if_fail (notification != NULL, FALSE);
 
         return notification->is_queued;
 }
@@ -226,62 +829,64 @@ nd_notification_get_is_queued (NdNotification *notification)
 gboolean
 nd_notification_get_is_closed (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), FALSE);
+        g_return_val_if_fail (notification != NULL, FALSE);
 
         return notification->is_closed;
 }
 
-static gboolean
-hint_to_boolean (NdNotification *notification,
-                 const gchar    *hint_name)
+gboolean
+nd_notification_get_is_transient (NdNotification *notification)
 {
-        GVariant *value;
-
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), FALSE);
+        g_return_val_if_fail (notification != NULL, FALSE);
 
-        value = g_hash_table_lookup (notification->hints, hint_name);
-        if (value == NULL)
-                return FALSE;
+        return notification->typed_hints.transient;
+}
 
-        if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT32)) {
-                return (g_variant_get_int32 (value) != 0);
-        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_DOUBLE)) {
-                return (g_variant_get_double (value) != 0);
-        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING)) {
-                return TRUE;
-        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_BYTE)) {
-                return (g_variant_get_byte (value) != 0);
-        } else if (g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN)) {
-                return g_variant_get_boolean (value);
-        } else {
-                g_assert_not_reached ();
-        }
+gboolean
+nd_notification_get_is_resident (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, FALSE);
 
-        return FALSE;
+        return notification->typed_hints.resident;
 }
 
 gboolean
-nd_notification_get_is_transient (NdNotification *notification)
+nd_notification_get_action_icons (NdNotification *notification)
 {
-        return hint_to_boolean (notification, "transient");
+        g_return_val_if_fail (notification != NULL, FALSE);
+
+        return notification->typed_hints.action_icons;
 }
 
-gboolean
-nd_notification_get_is_resident (NdNotification *notification)
+NdNotificationUrgency
+nd_notification_get_urgency (NdNotification *notification)
 {
-        return hint_to_boolean (notification, "resident");
+        g_return_val_if_fail (notification != NULL, ND_NOTIFICATION_URGENCY_NORMAL);
+
+        return notification->typed_hints.urgency;
 }
 
-gboolean
-nd_notification_get_action_icons (NdNotification *notification)
+/* Progress in percent from the "value" hint, or -1 */
+int
+nd_notification_get_value (NdNotification *notification)
 {
-        return hint_to_boolean (notification, "action-icons");
+        g_return_val_if_fail (notification != NULL, -1);
+
+        return notification->typed_hints.value;
+}
+
+gint64
+nd_notification_get_update_time (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, 0);
+
+        return notification->update_time;
 }
 
 guint32
 nd_notification_get_id (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), -1);
+        g_return_val_if_fail (notification != NULL, -1);
 
         return notification->id;
 }
@@ -289,7 +894,7 @@ nd_notification_get_id (NdNotification *notification)
 GHashTable *
 nd_notification_get_hints (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), NULL);
+        g_return_val_if_fail (notification != NULL, NULL);
 
         return notification->hints;
 }
@@ -297,7 +902,7 @@ nd_notification_get_hints (NdNotification *notification)
 char **
 nd_notification_get_actions (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), NULL);
+        g_return_val_if_fail (notification != NULL, NULL);
 
         return notification->actions;
 }
@@ -305,7 +910,7 @@ nd_notification_get_actions (NdNotification *notification)
 const char *
 nd_notification_get_sender (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), NULL);
+        g_return_val_if_fail (notification != NULL, NULL);
 
         return notification->sender;
 }
@@ -313,7 +918,7 @@ nd_notification_get_sender (NdNotification *notification)
 const char *
 nd_notification_get_summary (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), NULL);
+        g_return_val_if_fail (notification != NULL, NULL);
 
         return notification->summary;
 }
@@ -321,15 +926,45 @@ nd_notification_get_summary (NdNotification *notification)
 const char *
 nd_notification_get_body (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), NULL);
+        g_return_val_if_fail (notification != NULL, NULL);
 
         return notification->body;
 }
 
+PangoAttrList *
+nd_notification_get_summary_attrs (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, NULL);
+
+        ensure_parsed_text (notification);
+
+        return notification->summary_attrs;
+}
+
+const char *
+nd_notification_get_body_text (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, NULL);
+
+        ensure_parsed_text (notification);
+
+        return notification->body_text;
+}
+
+PangoAttrList *
+nd_notification_get_body_attrs (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, NULL);
+
+        ensure_parsed_text (notification);
+
+        return notification->body_attrs;
+}
+
 const char *
 nd_notification_get_icon (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), NULL);
+        g_return_val_if_fail (notification != NULL, NULL);
 
         return notification->icon;
 }
@@ -337,7 +972,7 @@ nd_notification_get_icon (NdNotification *notification)
 int
 nd_notification_get_timeout (NdNotification *notification)
 {
-        g_return_val_if_fail (ND_IS_NOTIFICATION (notification), -1);
+        g_return_val_if_fail (notification != NULL, -1);
 
         return notification->timeout;
 }
@@ -395,7 +1030,7 @@ _notify_daemon_pixbuf_from_data_hint (GVariant *icon_data,
         int             n_channels;
         GVariant       *data_variant;
         gsize           expected_len;
-        guchar         *data;
+        GBytes         *data;
         GdkPixbuf      *pixbuf;
 
         g_variant_get (icon_data,
@@ -416,21 +1051,24 @@ _notify_daemon_pixbuf_from_data_hint (GVariant *icon_data,
                            " but got a " "length of %" G_GSIZE_FORMAT,
                            expected_len,
                            g_variant_get_size (data_variant));
+                g_variant_unref (data_variant);
                 return NULL;
         }
 
-        data = (guchar *) g_memdup (g_variant_get_data (data_variant),
-                                    g_variant_get_size (data_variant));
+        /* Shares the hint's buffer, which for an image fd hint is
+           the mapping itself */
+        data = g_variant_get_data_as_bytes (data_variant);
+        g_variant_unref (data_variant);
+
+        pixbuf = gdk_pixbuf_new_from_bytes (data,
+                                            GDK_COLORSPACE_RGB,
+                                            has_alpha,
+                                            bits_per_sample,
+                                            width,
+                                            height,
+                                            rowstride);
+        g_bytes_unref (data);
 
-        pixbuf = gdk_pixbuf_new_from_data (data,
-                                           GDK_COLORSPACE_RGB,
-                                           has_alpha,
-                                           bits_per_sample,
-                                           width,
-                                           height,
-                                           rowstride,
-                                           (void *) g_free,
-                                           NULL);
         if (pixbuf != NULL && size > 0) {
                 GdkPixbuf *scaled;
                 scaled = scale_pixbuf (pixbuf, size, size, TRUE);
@@ -498,6 +1136,13 @@ nd_notification_load_image (NdNotification *notification,
         GVariant  *data;
         GdkPixbuf *pixbuf;
 
+        if (notification->image != NULL && notification->image_size == size)
+                return g_object_ref (notification->image);
+
+        /* Not updated yet */
+        if (notification->hints == NULL)
+                return NULL;
+
         pixbuf = NULL;
 
         if ((data = (GVariant *) g_hash_table_lookup (notification->hints, "image-data"))
@@ -519,40 +1164,261 @@ nd_notification_load_image (NdNotification *notification,
                 pixbuf = _notify_daemon_pixbuf_from_data_hint (data, size);
         }
 
+        if (pixbuf != NULL) {
+                g_clear_object (&notification->image);
+                notification->image = g_object_ref (pixbuf);
+                notification->image_size = size;
+        }
+
         return pixbuf;
 }
 
+/* Approximate number of bytes pinned by the notification: strings,
+ * hint values, parsed text and the decoded image.
+ */
+gsize
+nd_notification_get_memory_size (NdNotification *notification)
+{
+        GHashTableIter iter;
+        gpointer       key;
+        gpointer       value;
+        gsize          size;
+        int            i;
+
+        g_return_val_if_fail (notification != NULL, 0);
+
+        /* Pooled strings are counted in full for every notification
+           using them, which makes the total an upper bound */
+        size = sizeof (NdNotification);
+        size += notification->strings_size;
+        size += string_size (notification->body_text);
+        size += string_size (notification->sender);
+        size += string_size (notification->app_name);
+        size += string_size (notification->icon);
+
+        for (i = 0; notification->actions != NULL && notification->actions[i] != NULL; i += 2) {
+                size += string_size (notification->actions[i]);
+
+                if (notification->actions[i + 1] == NULL)
+                        break;
+        }
+
+        if (notification->hints != NULL) {
+                g_hash_table_iter_init (&iter, notification->hints);
+                while (g_hash_table_iter_next (&iter, &key, &value)) {
+                        size += string_size (key);
+                        size += g_variant_get_size (value);
+                }
+        }
+
+        if (notification->image != NULL)
+                size += gdk_pixbuf_get_byte_length (notification->image);
+
+        return size;
+}
+
+/* Turns a queued or shown notification into one that goes away on
+ * its own: it is no longer resident, is closed with its bubble,
+ * expires after the default timeout and is the first to be evicted.
+ * A notification that is only stored has no bubble to go away with.
+ */
+void
+nd_notification_demote (NdNotification *notification)
+{
+        g_return_if_fail (notification != NULL);
+
+        if (notification->hints == NULL)
+                notification->hints = nd_notification_hints_new ();
+
+        g_hash_table_insert (notification->hints,
+                             (gpointer) nd_string_pool_intern ("resident"),
+                             g_variant_ref_sink (g_variant_new_boolean (FALSE)));
+        g_hash_table_insert (notification->hints,
+                             (gpointer) nd_string_pool_intern ("transient"),
+                             g_variant_ref_sink (g_variant_new_boolean (TRUE)));
+        g_hash_table_insert (notification->hints,
+                             (gpointer) nd_string_pool_intern ("urgency"),
+                             g_variant_ref_sink (g_variant_new_byte (ND_NOTIFICATION_URGENCY_LOW)));
+
+        if (notification->timeout == 0) {
+                notification->timeout = -1;
+        }
+
+        parse_typed_hints (notification->hints, &notification->typed_hints);
+
+        emit_signal (notification, CHANGED, 0, NULL);
+}
+
+/* Folds @other into @notification, which then mentions it and the
+ * notifications folded into it in its body.  @other is not closed.
+ */
+void
+nd_notification_collapse (NdNotification *notification,
+                          NdNotification *other)
+{
+        g_return_if_fail (notification != NULL);
+        g_return_if_fail (other != NULL);
+
+        notification->n_collapsed += other->n_collapsed + 1;
+        clear_parsed_text (notification);
+
+        emit_signal (notification, CHANGED, 0, NULL);
+}
+
+guint
+nd_notification_get_n_collapsed (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, 0);
+
+        return notification->n_collapsed;
+}
+
+/* Drops the parsed text, which is parsed again when it is shown, and
+ * the raw image data hints once the image has been decoded at the
+ * size it is shown at.  Returns TRUE if anything was dropped.
+ */
+gboolean
+nd_notification_compact (NdNotification *notification)
+{
+        const char *const raw_hints[] = { "image-data", "image_data", "icon_data", NULL };
+        gboolean          had_text;
+        gboolean          has_raw;
+        int               i;
+
+        g_return_val_if_fail (notification != NULL, FALSE);
+
+        had_text = notification->text_parsed;
+        clear_parsed_text (notification);
+
+        has_raw = FALSE;
+        for (i = 0; notification->hints != NULL && raw_hints[i] != NULL; i++) {
+                has_raw |= g_hash_table_contains (notification->hints, raw_hints[i]);
+        }
+
+        if (!has_raw)
+                return had_text;
+
+        if (notification->image == NULL || notification->image_size != COMPACT_IMAGE_SIZE) {
+                GdkPixbuf *pixbuf;
+
+                pixbuf = nd_notification_load_image (notification, COMPACT_IMAGE_SIZE);
+                if (pixbuf == NULL)
+                        return had_text;
+
+                g_object_unref (pixbuf);
+        }
+
+        for (i = 0; raw_hints[i] != NULL; i++) {
+                g_hash_table_remove (notification->hints, raw_hints[i]);
+        }
+
+        return TRUE;
+}
+
 void
 nd_notification_close (NdNotification            *notification,
                        NdNotificationClosedReason reason)
 {
-        g_return_if_fail (ND_IS_NOTIFICATION (notification));
-
-        g_object_ref (notification);
-        g_signal_emit (notification, signals[CLOSED], 0, reason);
-        g_object_unref (notification);
+        g_return_if_fail (notification != NULL);
 
+        nd_notification_ref (notification);
+        emit_signal (notification, CLOSED, reason, NULL);
         notification->is_closed = TRUE;
+        nd_notification_unref (notification);
 }
 
 void
 nd_notification_action_invoked (NdNotification  *notification,
                                 const char      *action)
 {
-        g_return_if_fail (ND_IS_NOTIFICATION (notification));
+        g_return_if_fail (notification != NULL);
 
-        g_object_ref (notification);
-        g_signal_emit (notification, signals[ACTION_INVOKED], 0, action);
-        g_object_unref (notification);
+        emit_signal (notification, ACTION_INVOKED, 0, action);
 }
 
 NdNotification *
-nd_notification_new (const char *sender)
+nd_notification_new (const char *sender,
+                     guint32     id)
 {
         NdNotification *notification;
 
-        notification = (NdNotification *) g_object_new (ND_TYPE_NOTIFICATION, NULL);
-        notification->sender = g_strdup (sender);
+        notification = g_slice_new0 (NdNotification);
+        notification->ref_count = 1;
+        notification->sender = nd_string_pool_intern (sender);
+        notification->id = id;
+        notification->typed_hints.urgency = ND_NOTIFICATION_URGENCY_NORMAL;
+        notification->typed_hints.value = -1;
 
         return notification;
 }
+
+NdNotification *
+nd_notification_ref (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, NULL);
+
+        g_atomic_int_inc (&notification->ref_count);
+
+        return notification;
+}
+
+void
+nd_notification_unref (NdNotification *notification)
+{
+        g_return_if_fail (notification != NULL);
+
+        if (!g_atomic_int_dec_and_test (&notification->ref_count))
+                return;
+
+        if (notification->binding != NULL)
+                g_object_remove_weak_pointer (notification->binding,
+                                              (gpointer *) &notification->binding);
+
+        nd_string_pool_release (notification->sender);
+        release_strings (notification->app_name,
+                         notification->icon,
+                         notification->actions);
+        clear_parsed_text (notification);
+        g_clear_object (&notification->image);
+
+        if (notification->hints != NULL) {
+                g_hash_table_unref (notification->hints);
+        }
+
+        g_slice_free (NdNotification, notification);
+}
+
+/* Returns the object that emits ::changed, ::value-changed, ::closed
+ * and ::action-invoked for @notification, for a bubble or a dock row
+ * that shows it.  It is created by the first binding and dropped by
+ * the last nd_notification_unbind().  The caller keeps its own
+ * reference to @notification while bound.
+ */
+GObject *
+nd_notification_bind (NdNotification *notification)
+{
+        g_return_val_if_fail (notification != NULL, NULL);
+
+        if (notification->binding != NULL)
+                return g_object_ref (notification->binding);
+
+        notification->binding = g_object_new (nd_notification_binding_get_type (), NULL);
+        g_object_add_weak_pointer (notification->binding,
+                                   (gpointer *) &notification->binding);
+
+        return notification->binding;
+}
+
+/* Disconnects the handlers of the binding whose data is @data, and
+ * gives back the binding taken by nd_notification_bind().
+ */
+void
+nd_notification_unbind (NdNotification *notification,
+                        gpointer        data)
+{
+        g_return_if_fail (notification != NULL);
+        g_return_if_fail (notification->binding != NULL);
+
+        g_signal_handlers_disconnect_by_data (notification->binding, data);
+        g_object_unref (notification->binding);
+}
@@ -21,21 +21,16 @@
 #define __ND_NOTIFICATION__ 1
 
 #include <glib-object.h>
+#include <gio/gunixfdlist.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <pango/pango.h>
 
 G_BEGIN_DECLS
 
 #define ND_TYPE_NOTIFICATION (nd_notification_get_type ())
-#define ND_NOTIFICATION(object) (G_TYPE_CHECK_INSTANCE_CAST ((object), ND_TYPE_NOTIFICATION, NdNotification))
-#define ND_IS_NOTIFICATION(object) (G_TYPE_CHECK_INSTANCE_TYPE ((object), ND_TYPE_NOTIFICATION))
 
 typedef struct _NdNotification NdNotification;
 
-typedef struct _NdNotificationClass
-{
-        GObjectClass parent_class;
-} NdNotificationClass;
-
 typedef enum
 {
         ND_NOTIFICATION_CLOSED_EXPIRED = 1,
@@ -44,16 +39,66 @@ typedef enum
         ND_NOTIFICATION_CLOSED_RESERVED = 4
 } NdNotificationClosedReason;
 
+typedef enum
+{
+        ND_NOTIFICATION_URGENCY_LOW = 0,
+        ND_NOTIFICATION_URGENCY_NORMAL = 1,
+        ND_NOTIFICATION_URGENCY_CRITICAL = 2
+} NdNotificationUrgency;
+
+/* Vendor hint of type (hiiii): a sealed memfd holding the image,
+   then its width, height, rowstride and NdNotificationImageFormat */
+#define ND_NOTIFICATION_IMAGE_FD_HINT "x-nd-image-memfd"
+
+typedef enum
+{
+        ND_NOTIFICATION_IMAGE_FORMAT_RGB24 = 0,
+        ND_NOTIFICATION_IMAGE_FORMAT_RGBA32 = 1
+} NdNotificationImageFormat;
+
+/* Told about every notification, before the handlers connected to its
+   binding.  Any of the callbacks may be NULL. */
+typedef struct
+{
+        void (* changed)        (NdNotification *notification,
+                                 gpointer        user_data);
+        void (* value_changed)  (NdNotification *notification,
+                                 gpointer        user_data);
+        void (* closed)         (NdNotification *notification,
+                                 int             reason,
+                                 gpointer        user_data);
+        void (* action_invoked) (NdNotification *notification,
+                                 const char     *action,
+                                 gpointer        user_data);
+} NdNotificationObserver;
+
 GType                 nd_notification_get_type            (void) G_GNUC_CONST;
 
-NdNotification *      nd_notification_new                 (const char     *sender);
+void                  nd_notification_add_observer        (const NdNotificationObserver *observer,
+                                                           gpointer                      user_data);
+void                  nd_notification_remove_observer     (const NdNotificationObserver *observer,
+                                                           gpointer                      user_data);
+
+GHashTable *          nd_notification_hints_new           (void);
+GHashTable *          nd_notification_parse_hints         (GVariant       *hints,
+                                                           GUnixFDList    *fd_list);
+
+NdNotification *      nd_notification_new                 (const char     *sender,
+                                                           guint32         id);
+NdNotification *      nd_notification_ref                 (NdNotification *notification);
+void                  nd_notification_unref               (NdNotification *notification);
+
+GObject *             nd_notification_bind                (NdNotification *notification);
+void                  nd_notification_unbind              (NdNotification *notification,
+                                                           gpointer        data);
+
 gboolean              nd_notification_update              (NdNotification     *notification,
                                                            const gchar        *app_name,
                                                            const gchar        *icon,
                                                            const gchar        *summary,
                                                            const gchar        *body,
                                                            const gchar *const *actions,
-                                                           GVariant           *hints,
+                                                           GHashTable         *hints,
                                                            gint                timeout);
 
 void                  nd_notification_set_is_queued       (NdNotification *notification,
@@ -69,6 +114,9 @@ const char *          nd_notification_get_app_name        (NdNotification *notif
 const char *          nd_notification_get_icon            (NdNotification *notification);
 const char *          nd_notification_get_summary         (NdNotification *notification);
 const char *          nd_notification_get_body            (NdNotification *notification);
+PangoAttrList *       nd_notification_get_summary_attrs   (NdNotification *notification);
+const char *          nd_notification_get_body_text       (NdNotification *notification);
+PangoAttrList *       nd_notification_get_body_attrs      (NdNotification *notification);
 char **               nd_notification_get_actions         (NdNotification *notification);
 GHashTable *          nd_notification_get_hints           (NdNotification *notification);
 
@@ -77,6 +125,16 @@ GdkPixbuf *           nd_notification_load_image          (NdNotification *notif
 gboolean              nd_notification_get_is_resident     (NdNotification *notification);
 gboolean              nd_notification_get_is_transient    (NdNotification *notification);
 gboolean              nd_notification_get_action_icons    (NdNotification *notification);
+NdNotificationUrgency nd_notification_get_urgency         (NdNotification *notification);
+int                   nd_notification_get_value           (NdNotification *notification);
+gint64                nd_notification_get_update_time     (NdNotification *notification);
+
+gsize                 nd_notification_get_memory_size     (NdNotification *notification);
+gboolean              nd_notification_compact             (NdNotification *notification);
+void                  nd_notification_demote              (NdNotification *notification);
+void                  nd_notification_collapse            (NdNotification *notification,
+                                                           NdNotification *other);
+guint                 nd_notification_get_n_collapsed     (NdNotification *notification);
 
 void                  nd_notification_close               (NdNotification *notification,
                                                            NdNotificationClosedReason reason);
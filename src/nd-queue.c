@@ -32,19 +32,34 @@
 
 #include "nd-queue.h"
 
+#include "nd-eviction-index.h"
 #include "nd-notification.h"
 #include "nd-notification-box.h"
 #include "nd-stack.h"
+#include "nd-string-pool.h"
+#include "nd-watchdog.h"
 
 #define ND_QUEUE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ND_TYPE_QUEUE, NdQueuePrivate))
 
 #define WIDTH         400
+#define DOCK_SPACING  6
+
+/* Same as the default expiration time of the bubbles */
+#define DEFAULT_TIMEOUT_MS 5000
 
 typedef struct
 {
+        NdQueue    *queue;
         NdStack   **stacks;
         int         n_stacks;
         Atom        workarea_atom;
+        Atom        current_desktop_atom;
+
+        /* The active window, watched for going fullscreen */
+        Atom        active_window_atom;
+        Atom        wm_state_atom;
+        Atom        wm_state_fullscreen_atom;
+        Window      active_window;
 } NotifyScreen;
 
 struct NdQueuePrivate
@@ -61,6 +76,43 @@ struct NdQueuePrivate
         NotifyScreen  *screen;
 
         guint          update_id;
+
+        gboolean       animate;
+        gboolean       single_surface;
+
+        /* While inhibited only critical notifications are shown, the
+           ids of the others are kept for a summary afterwards */
+        gboolean       inhibited;
+        GHashTable    *held;
+
+        /* The summary of held notifications, until there is a place
+           to show it */
+        NdNotification *held_summary;
+        guint          n_summarized;
+
+        /* Stored notifications in the order they are evicted in */
+        NdEvictionIndex *eviction_index;
+
+        /* Stands in for the queued notifications that do not fit in
+           the stack they would be shown in */
+        NdNotification *overflow_summary;
+        NdBubble      *overflow_bubble;
+        NdStack       *overflow_stack;
+        guint          n_overflow;
+
+        guint          freeze_count;
+        gboolean       changed_pending;
+        gboolean       update_pending;
+
+        /* Sum of the memory sizes of the stored notifications, as
+           they were last counted in memory_sizes */
+        gsize          memory_usage;
+        GHashTable    *memory_sizes;
+
+        gsize          memory_budget;
+        guint          n_compacted;
+        guint          n_evicted;
+        guint          n_stale;
 };
 
 enum {
@@ -72,12 +124,37 @@ static guint signals [LAST_SIGNAL] = { 0, };
 
 static void     nd_queue_finalize       (GObject        *object);
 static void     queue_update            (NdQueue        *queue);
+static void     emit_changed            (NdQueue        *queue);
 static void     on_notification_close   (NdNotification *notification,
                                          int             reason,
+                                         gpointer        user_data);
+static void     on_notification_changed (NdNotification *notification,
+                                         gpointer        user_data);
+static void     on_summary_action_invoked (NdNotification *notification,
+                                           const char     *action,
+                                           gpointer        user_data);
+
+static void     on_notification_hidden  (NdStack        *stack,
+                                         NdNotification *notification,
                                          NdQueue        *queue);
+static void     show_dock               (NdQueue        *queue);
+static NdNotification *new_summary      (NdQueue        *queue);
+static void     update_summary          (NdNotification *summary,
+                                         const char     *text,
+                                         int             timeout);
+static void     update_fullscreen       (NotifyScreen   *nscreen);
+static void     show_held_summary       (NdQueue        *queue,
+                                         NdStack        *pointer_stack);
 
 static gpointer queue_object = NULL;
 
+static const NdNotificationObserver notification_observer = {
+        on_notification_changed,
+        on_notification_changed,
+        on_notification_close,
+        on_summary_action_invoked
+};
+
 G_DEFINE_TYPE_WITH_PRIVATE (NdQueue, nd_queue, G_TYPE_OBJECT)
 
 static void
@@ -91,6 +168,14 @@ create_stack_for_monitor (NdQueue    *queue,
 
         nscreen->stacks[monitor_num] = nd_stack_new (screen,
                                                      monitor_num);
+        nd_stack_set_animate (nscreen->stacks[monitor_num],
+                              queue->priv->animate);
+        nd_stack_set_single_surface (nscreen->stacks[monitor_num],
+                                     queue->priv->single_surface);
+        g_signal_connect (nscreen->stacks[monitor_num],
+                          "notification-hidden",
+                          G_CALLBACK (on_notification_hidden),
+                          queue);
 }
 
 static void
@@ -104,7 +189,11 @@ on_screen_monitors_changed (GdkScreen *screen,
         nscreen = queue->priv->screen;
 
         n_monitors = gdk_display_get_n_monitors(gdk_screen_get_display(screen));
-                     
+
+        for (i = 0; i < MIN (n_monitors, nscreen->n_stacks); i++) {
+                nd_stack_invalidate_work_area (nscreen->stacks[i]);
+        }
+
         if (n_monitors > nscreen->n_stacks) {
                 /* grow */
                 nscreen->stacks = g_renew (NdStack *,
@@ -138,6 +227,11 @@ on_screen_monitors_changed (GdkScreen *screen,
                                 nd_stack_add_bubble (last_stack, l->data, TRUE);
                         }
                         g_list_free (bubbles);
+
+                        if (queue->priv->overflow_stack == stack) {
+                                queue->priv->overflow_stack = last_stack;
+                        }
+
                         g_object_unref (stack);
                         nscreen->stacks[i] = NULL;
                 }
@@ -148,6 +242,8 @@ on_screen_monitors_changed (GdkScreen *screen,
                                            n_monitors);
                 nscreen->n_stacks = n_monitors;
         }
+
+        update_fullscreen (nscreen);
 }
 
 static void
@@ -170,22 +266,206 @@ create_stacks_for_screen (NdQueue   *queue,
         }
 }
 
+static Window
+get_active_window (Display      *xdisplay,
+                   NotifyScreen *nscreen)
+{
+        Atom           type;
+        int            format;
+        unsigned long  n_items;
+        unsigned long  bytes_after;
+        guchar        *data;
+        Window         window;
+        int            result;
+
+        data = NULL;
+        window = None;
+
+        result = XGetWindowProperty (xdisplay,
+                                     gdk_x11_get_default_root_xwindow (),
+                                     nscreen->active_window_atom,
+                                     0, 1, False, XA_WINDOW,
+                                     &type, &format, &n_items, &bytes_after,
+                                     &data);
+
+        if (result == Success && data != NULL) {
+                if (type == XA_WINDOW && format == 32 && n_items > 0) {
+                        window = ((Window *) data)[0];
+                }
+
+                XFree (data);
+        }
+
+        return window;
+}
+
+static gboolean
+get_window_is_fullscreen (Display      *xdisplay,
+                          NotifyScreen *nscreen,
+                          Window        window)
+{
+        Atom           type;
+        int            format;
+        unsigned long  n_items;
+        unsigned long  bytes_after;
+        unsigned long  i;
+        guchar        *data;
+        gboolean       fullscreen;
+        int            result;
+
+        data = NULL;
+        fullscreen = FALSE;
+
+        result = XGetWindowProperty (xdisplay, window,
+                                     nscreen->wm_state_atom,
+                                     0, G_MAXLONG, False, XA_ATOM,
+                                     &type, &format, &n_items, &bytes_after,
+                                     &data);
+
+        if (result == Success && data != NULL) {
+                if (type == XA_ATOM && format == 32) {
+                        for (i = 0; i < n_items; i++) {
+                                if (((Atom *) data)[i] == nscreen->wm_state_fullscreen_atom)
+                                        fullscreen = TRUE;
+                        }
+                }
+
+                XFree (data);
+        }
+
+        return fullscreen;
+}
+
+/* Index of the monitor under the center of @window, or -1 */
+static int
+get_window_monitor (GdkDisplay *display,
+                    Window      window)
+{
+        Display           *xdisplay;
+        XWindowAttributes  attrs;
+        GdkMonitor        *monitor;
+        Window             child;
+        int                scale;
+        int                x;
+        int                y;
+        int                i;
+
+        xdisplay = GDK_DISPLAY_XDISPLAY (display);
+
+        if (!XGetWindowAttributes (xdisplay, window, &attrs)
+            || !XTranslateCoordinates (xdisplay, window, attrs.root,
+                                       attrs.width / 2, attrs.height / 2,
+                                       &x, &y, &child)) {
+                return -1;
+        }
+
+        scale = gdk_window_get_scale_factor (gdk_get_default_root_window ());
+        monitor = gdk_display_get_monitor_at_point (display, x / scale, y / scale);
+
+        for (i = 0; i < gdk_display_get_n_monitors (display); i++) {
+                if (gdk_display_get_monitor (display, i) == monitor)
+                        return i;
+        }
+
+        return -1;
+}
+
+/* Finds out which monitor, if any, the active window fills.  Only runs
+ * when the active window or its state changes; the stacks keep the
+ * outcome, so showing a notification costs no round-trip.
+ */
+static void
+update_fullscreen (NotifyScreen *nscreen)
+{
+        GdkDisplay *display;
+        Display    *xdisplay;
+        Window      active;
+        gboolean    changed;
+        int         fullscreen_monitor;
+        int         i;
+
+        display = gdk_display_get_default ();
+        xdisplay = GDK_DISPLAY_XDISPLAY (display);
+        fullscreen_monitor = -1;
+
+        gdk_x11_display_error_trap_push (display);
+
+        active = get_active_window (xdisplay, nscreen);
+
+        /* Our own windows already select property changes */
+        if (active != nscreen->active_window) {
+                if (nscreen->active_window != None
+                    && gdk_x11_window_lookup_for_display (display, nscreen->active_window) == NULL) {
+                        XSelectInput (xdisplay, nscreen->active_window, NoEventMask);
+                }
+
+                if (active != None
+                    && gdk_x11_window_lookup_for_display (display, active) == NULL) {
+                        XSelectInput (xdisplay, active, PropertyChangeMask);
+                }
+
+                nscreen->active_window = active;
+        }
+
+        if (active != None && get_window_is_fullscreen (xdisplay, nscreen, active)) {
+                fullscreen_monitor = get_window_monitor (display, active);
+        }
+
+        gdk_x11_display_error_trap_pop_ignored (display);
+
+        changed = FALSE;
+        for (i = 0; i < nscreen->n_stacks; i++) {
+                gboolean fullscreen = (i == fullscreen_monitor);
+
+                if (nd_stack_get_fullscreen (nscreen->stacks[i]) != fullscreen) {
+                        nd_stack_set_fullscreen (nscreen->stacks[i], fullscreen);
+                        changed = TRUE;
+                }
+        }
+
+        if (changed) {
+                g_debug ("Fullscreen monitor is now %d", fullscreen_monitor);
+                queue_update (nscreen->queue);
+        }
+}
+
+/* Installed for all windows, so that it also sees the property
+ * changes of the active window, which is not ours.
+ */
 static GdkFilterReturn
 screen_xevent_filter (GdkXEvent    *xevent,
                       GdkEvent     *event,
                       NotifyScreen *nscreen)
 {
         XEvent *xev;
+        Window  root;
 
         xev = (XEvent *) xevent;
 
-        if (xev->type == PropertyNotify &&
-            xev->xproperty.atom == nscreen->workarea_atom) {
+        if (xev->type != PropertyNotify)
+                return GDK_FILTER_CONTINUE;
+
+        root = gdk_x11_get_default_root_xwindow ();
+
+        if (xev->xproperty.window == root &&
+            (xev->xproperty.atom == nscreen->workarea_atom ||
+             xev->xproperty.atom == nscreen->current_desktop_atom)) {
                 int i;
 
+                nd_watchdog_trace ("work-area-changed");
+
                 for (i = 0; i < nscreen->n_stacks; i++) {
-                        nd_stack_queue_update_position (nscreen->stacks[i]);
+                        nd_stack_invalidate_work_area (nscreen->stacks[i]);
                 }
+
+                /* more or fewer bubbles may fit now */
+                queue_update (nscreen->queue);
+        } else if ((xev->xproperty.window == root &&
+                    xev->xproperty.atom == nscreen->active_window_atom) ||
+                   (xev->xproperty.window == nscreen->active_window &&
+                    xev->xproperty.window != None &&
+                    xev->xproperty.atom == nscreen->wm_state_atom)) {
+                update_fullscreen (nscreen);
         }
 
         return GDK_FILTER_CONTINUE;
@@ -209,13 +489,19 @@ create_screen (NdQueue *queue)
                           queue);
 
         queue->priv->screen = g_new0 (NotifyScreen, 1);
+        queue->priv->screen->queue = queue;
         queue->priv->screen->workarea_atom = XInternAtom (GDK_DISPLAY_XDISPLAY (display), "_NET_WORKAREA", True);
+        queue->priv->screen->current_desktop_atom = XInternAtom (GDK_DISPLAY_XDISPLAY (display), "_NET_CURRENT_DESKTOP", True);
+        queue->priv->screen->active_window_atom = XInternAtom (GDK_DISPLAY_XDISPLAY (display), "_NET_ACTIVE_WINDOW", False);
+        queue->priv->screen->wm_state_atom = XInternAtom (GDK_DISPLAY_XDISPLAY (display), "_NET_WM_STATE", False);
+        queue->priv->screen->wm_state_fullscreen_atom = XInternAtom (GDK_DISPLAY_XDISPLAY (display), "_NET_WM_STATE_FULLSCREEN", False);
 
         gdkwindow = gdk_screen_get_root_window (screen);
-        gdk_window_add_filter (gdkwindow, (GdkFilterFunc) screen_xevent_filter, queue->priv->screen);
+        gdk_window_add_filter (NULL, (GdkFilterFunc) screen_xevent_filter, queue->priv->screen);
         gdk_window_set_events (gdkwindow, gdk_window_get_events (gdkwindow) | GDK_PROPERTY_CHANGE_MASK);
 
         create_stacks_for_screen (queue, screen);
+        update_fullscreen (queue->priv->screen);
 }
 
 static void
@@ -344,29 +630,38 @@ clear_stacks (NdQueue *queue)
 static void
 _nd_queue_remove_all (NdQueue *queue)
 {
-        GHashTableIter iter;
-        gpointer       key, value;
-        gboolean       changed;
+        GList    *notifications;
+        GList    *l;
+        gboolean  changed;
 
         changed = FALSE;
 
         clear_stacks (queue);
 
         g_queue_clear (queue->priv->queue);
-        g_hash_table_iter_init (&iter, queue->priv->notifications);
-        while (g_hash_table_iter_next (&iter, &key, &value)) {
-                NdNotification *n = ND_NOTIFICATION (value);
-
-                g_signal_handlers_disconnect_by_func (n, G_CALLBACK (on_notification_close), queue);
-                nd_notification_close (n, ND_NOTIFICATION_CLOSED_USER);
-                g_hash_table_iter_remove (&iter);
+        g_hash_table_remove_all (queue->priv->held);
+        g_clear_pointer (&queue->priv->held_summary, nd_notification_unref);
+        nd_eviction_index_remove_all (queue->priv->eviction_index);
+        g_hash_table_remove_all (queue->priv->memory_sizes);
+        queue->priv->memory_usage = 0;
+
+        /* Closed once no longer stored, so that the queue does not
+           remove them again */
+        notifications = g_hash_table_get_values (queue->priv->notifications);
+        g_list_foreach (notifications, (GFunc) nd_notification_ref, NULL);
+        g_hash_table_remove_all (queue->priv->notifications);
+
+        for (l = notifications; l != NULL; l = l->next) {
+                nd_notification_close (l->data, ND_NOTIFICATION_CLOSED_USER);
                 changed = TRUE;
         }
+
+        g_list_free_full (notifications, (GDestroyNotify) nd_notification_unref);
         popdown_dock (queue);
         queue_update (queue);
 
         if (changed) {
-                g_signal_emit (queue, signals[CHANGED], 0);
+                emit_changed (queue);
         }
 }
 
@@ -459,13 +754,18 @@ static void
 nd_queue_init (NdQueue *queue)
 {
         queue->priv = nd_queue_get_instance_private (queue);
-        queue->priv->notifications = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
+        queue->priv->notifications = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) nd_notification_unref);
         queue->priv->bubbles = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
         queue->priv->queue = g_queue_new ();
+        queue->priv->held = g_hash_table_new (NULL, NULL);
+        queue->priv->eviction_index = nd_eviction_index_new ();
+        queue->priv->memory_sizes = g_hash_table_new (NULL, NULL);
         queue->priv->status_icon = NULL;
 
         create_dock (queue);
         create_screen (queue);
+
+        nd_notification_add_observer (&notification_observer, queue);
 }
 
 static void
@@ -473,7 +773,6 @@ destroy_screen (NdQueue *queue)
 {
         GdkDisplay *display;
         GdkScreen  *screen;
-        GdkWindow  *gdkwindow;
         gint        i;
 
         display = gdk_display_get_default ();
@@ -483,8 +782,7 @@ destroy_screen (NdQueue *queue)
                                               G_CALLBACK (on_screen_monitors_changed),
                                               queue);
 
-        gdkwindow = gdk_screen_get_root_window (screen);
-        gdk_window_remove_filter (gdkwindow, (GdkFilterFunc) screen_xevent_filter, queue->priv->screen);
+        gdk_window_remove_filter (NULL, (GdkFilterFunc) screen_xevent_filter, queue->priv->screen);
         for (i = 0; i < queue->priv->screen->n_stacks; i++) {
                 g_clear_object (&queue->priv->screen->stacks[i]);
         }
@@ -508,11 +806,22 @@ nd_queue_finalize (GObject *object)
 
         g_return_if_fail (queue->priv != NULL);
 
+        nd_notification_remove_observer (&notification_observer, queue);
+
         if (queue->priv->update_id != 0) {
                 g_source_remove (queue->priv->update_id);
         }
 
+        if (queue->priv->overflow_bubble != NULL) {
+                gtk_widget_destroy (GTK_WIDGET (queue->priv->overflow_bubble));
+        }
+        g_clear_pointer (&queue->priv->overflow_summary, nd_notification_unref);
+
         g_hash_table_destroy (queue->priv->notifications);
+        g_hash_table_destroy (queue->priv->held);
+        g_clear_pointer (&queue->priv->held_summary, nd_notification_unref);
+        nd_eviction_index_free (queue->priv->eviction_index);
+        g_hash_table_destroy (queue->priv->memory_sizes);
         g_queue_free (queue->priv->queue);
 
         destroy_screen (queue);
@@ -545,6 +854,27 @@ nd_queue_length (NdQueue *queue)
         return g_hash_table_size (queue->priv->notifications);
 }
 
+/* Returns the stored notification to evict first: the oldest of the
+ * lowest urgency.
+ */
+NdNotification *
+nd_queue_get_lowest_urgency (NdQueue *queue)
+{
+        g_return_val_if_fail (ND_IS_QUEUE (queue), NULL);
+
+        return nd_eviction_index_get_lowest (queue->priv->eviction_index);
+}
+
+NdNotification *
+nd_queue_get_oldest_from (NdQueue    *queue,
+                          const char *sender)
+{
+        g_return_val_if_fail (ND_IS_QUEUE (queue), NULL);
+
+        return nd_eviction_index_get_oldest_from (queue->priv->eviction_index,
+                                                  sender);
+}
+
 static NdStack *
 get_stack_with_pointer (NdQueue *queue)
 {
@@ -578,17 +908,82 @@ get_stack_with_pointer (NdQueue *queue)
        return queue->priv->screen->stacks[0];
 }
 
+/* A stack that no fullscreen window covers, preferring @stack */
+static NdStack *
+get_stack_without_fullscreen (NdQueue *queue,
+                              NdStack *stack)
+{
+        NotifyScreen *nscreen;
+        int           i;
+
+        if (!nd_stack_get_fullscreen (stack))
+                return stack;
+
+        nscreen = queue->priv->screen;
+        for (i = 0; i < nscreen->n_stacks; i++) {
+                if (!nd_stack_get_fullscreen (nscreen->stacks[i]))
+                        return nscreen->stacks[i];
+        }
+
+        return NULL;
+}
+
+/* The queue is told about every notification, including the ones it
+ * does not store or no longer does.
+ */
+static gboolean
+is_stored (NdQueue        *queue,
+           NdNotification *notification)
+{
+        guint id;
+
+        id = nd_notification_get_id (notification);
+
+        return g_hash_table_lookup (queue->priv->notifications, GUINT_TO_POINTER (id)) == notification;
+}
+
+/* Counts @notification again in the memory usage, after it was added,
+ * changed or compacted, or shown and so given its image.
+ */
 static void
-on_bubble_destroyed (NdBubble *bubble,
-                     NdQueue  *queue)
+update_memory_size (NdQueue        *queue,
+                    NdNotification *notification)
 {
-        NdNotification *notification;
+        gpointer key;
+        gsize    old_size;
+        gsize    size;
 
-        g_debug ("Bubble destroyed");
-        notification = nd_bubble_get_notification (bubble);
+        key = GUINT_TO_POINTER (nd_notification_get_id (notification));
+        old_size = GPOINTER_TO_SIZE (g_hash_table_lookup (queue->priv->memory_sizes, key));
+        size = nd_notification_get_memory_size (notification);
 
+        queue->priv->memory_usage = queue->priv->memory_usage - old_size + size;
+        g_hash_table_insert (queue->priv->memory_sizes, key, GSIZE_TO_POINTER (size));
+}
+
+static void
+forget_memory_size (NdQueue        *queue,
+                    NdNotification *notification)
+{
+        gpointer key;
+
+        key = GUINT_TO_POINTER (nd_notification_get_id (notification));
+
+        queue->priv->memory_usage -= GPOINTER_TO_SIZE (g_hash_table_lookup (queue->priv->memory_sizes, key));
+        g_hash_table_remove (queue->priv->memory_sizes, key);
+}
+
+static void
+on_notification_hidden (NdStack        *stack,
+                        NdNotification *notification,
+                        NdQueue        *queue)
+{
         nd_notification_set_is_queued (notification, FALSE);
 
+        if (is_stored (queue, notification)) {
+                update_memory_size (queue, notification);
+        }
+
         if (nd_notification_get_is_transient (notification)) {
                 g_debug ("Bubble is transient");
                 nd_notification_close (notification, ND_NOTIFICATION_CLOSED_EXPIRED);
@@ -597,16 +992,198 @@ on_bubble_destroyed (NdBubble *bubble,
         queue_update (queue);
 }
 
+static void
+on_bubble_destroyed (NdBubble *bubble,
+                     NdQueue  *queue)
+{
+        g_debug ("Bubble destroyed");
+
+        on_notification_hidden (NULL, nd_bubble_get_notification (bubble), queue);
+}
+
+/* Real time after which a queued notification is no longer worth a
+ * bubble, counted from its last update, or G_MAXINT64.  Critical
+ * notifications are always shown.
+ */
+static gint64
+get_display_deadline (NdNotification *notification)
+{
+        int timeout;
+
+        if (nd_notification_get_urgency (notification) == ND_NOTIFICATION_URGENCY_CRITICAL)
+                return G_MAXINT64;
+
+        timeout = nd_notification_get_timeout (notification);
+        if (timeout == 0)
+                return G_MAXINT64;
+
+        if (timeout < 0)
+                timeout = DEFAULT_TIMEOUT_MS;
+
+        return nd_notification_get_update_time (notification) + (gint64) timeout * 1000;
+}
+
+/* Takes notifications that expired while waiting in the queue out of
+ * it, without ever building a bubble for them.  They are handled as if
+ * their bubble had timed out, and the transient ones are closed as
+ * expired in a single transaction.
+ */
+static void
+drop_stale_notifications (NdQueue *queue)
+{
+        GList  *stale;
+        GList  *l;
+        GList  *next;
+        gint64  now;
+
+        now = g_get_real_time ();
+        stale = NULL;
+
+        for (l = queue->priv->queue->head; l != NULL; l = next) {
+                NdNotification *notification;
+
+                next = l->next;
+
+                notification = g_hash_table_lookup (queue->priv->notifications, l->data);
+                if (now < get_display_deadline (notification))
+                        continue;
+
+                g_queue_delete_link (queue->priv->queue, l);
+                stale = g_list_prepend (stale, nd_notification_ref (notification));
+        }
+
+        if (stale == NULL)
+                return;
+
+        g_debug ("Dropping %u stale notifications", g_list_length (stale));
+
+        nd_queue_freeze (queue);
+
+        for (l = stale; l != NULL; l = l->next) {
+                NdNotification *notification = l->data;
+
+                queue->priv->n_stale++;
+                nd_notification_set_is_queued (notification, FALSE);
+
+                if (nd_notification_get_is_transient (notification)) {
+                        nd_notification_close (notification, ND_NOTIFICATION_CLOSED_EXPIRED);
+                }
+        }
+
+        nd_queue_thaw (queue);
+
+        g_list_free_full (stale, (GDestroyNotify) nd_notification_unref);
+}
+
+static void
+set_overflow_count (NdQueue *queue,
+                    guint    n_more)
+{
+        char *text;
+
+        if (queue->priv->n_overflow == n_more)
+                return;
+
+        queue->priv->n_overflow = n_more;
+
+        text = g_strdup_printf (ngettext ("%u more notification",
+                                          "%u more notifications",
+                                          n_more),
+                                n_more);
+
+        update_summary (queue->priv->overflow_summary, text, 0);
+        g_free (text);
+}
+
+static void
+on_overflow_bubble_destroyed (NdBubble *bubble,
+                              NdQueue  *queue)
+{
+        queue->priv->overflow_bubble = NULL;
+        queue->priv->overflow_stack = NULL;
+
+        /* It may have been closed along with the bubble */
+        g_clear_pointer (&queue->priv->overflow_summary, nd_notification_unref);
+}
+
+/* The notification of the overflow bubble, which exists before the
+ * bubble does so that the room for it can be estimated.
+ */
+static void
+ensure_overflow_summary (NdQueue *queue)
+{
+        if (queue->priv->overflow_summary != NULL)
+                return;
+
+        queue->priv->overflow_summary = new_summary (queue);
+
+        queue->priv->n_overflow = 0;
+        set_overflow_count (queue, MAX (g_queue_get_length (queue->priv->queue), 1));
+}
+
+/* Room to keep in @stack for the overflow bubble, when more than the
+ * next notification is queued and the bubble is not there already.
+ */
+static int
+get_overflow_reserve (NdQueue *queue,
+                      NdStack *stack)
+{
+        if (g_queue_get_length (queue->priv->queue) <= 1
+            || queue->priv->overflow_stack == stack)
+                return 0;
+
+        ensure_overflow_summary (queue);
+
+        return nd_bubble_estimate_height (queue->priv->overflow_summary);
+}
+
+/* Shows the number of queued notifications at the end of @stack, the
+ * stack that ran out of room, or takes the overflow bubble away if
+ * it is NULL.
+ */
+static void
+update_overflow_bubble (NdQueue *queue,
+                        NdStack *stack)
+{
+        guint n_more;
+
+        n_more = g_queue_get_length (queue->priv->queue);
+
+        if (queue->priv->overflow_bubble != NULL
+            && (stack == NULL || n_more == 0
+                || (queue->priv->overflow_stack != NULL && queue->priv->overflow_stack != stack))) {
+                gtk_widget_destroy (GTK_WIDGET (queue->priv->overflow_bubble));
+        }
+
+        if (stack == NULL || n_more == 0)
+                return;
+
+        ensure_overflow_summary (queue);
+        set_overflow_count (queue, n_more);
+
+        if (queue->priv->overflow_bubble == NULL) {
+                queue->priv->overflow_bubble = nd_bubble_new_for_notification (queue->priv->overflow_summary);
+                g_signal_connect (queue->priv->overflow_bubble,
+                                  "destroy",
+                                  G_CALLBACK (on_overflow_bubble_destroyed),
+                                  queue);
+        }
+
+        if (queue->priv->overflow_stack == NULL) {
+                nd_stack_add_bubble (stack, queue->priv->overflow_bubble, TRUE);
+                queue->priv->overflow_stack = stack;
+        }
+}
+
 static void
 maybe_show_notification (NdQueue *queue)
 {
-        gpointer        id;
-        NdNotification *notification;
-        NdBubble       *bubble;
-        NdStack        *stack;
-        GList          *list;
+        NdStack *pointer_stack;
+        NdStack *full_stack;
+        GList   *l;
+        GList   *prev;
 
-        /* FIXME: show one at a time if not busy or away */
+        drop_stale_notifications (queue);
 
         /* don't show bubbles when dock is showing */
         if (gtk_widget_get_visible (queue->priv->dock)) {
@@ -614,28 +1191,239 @@ maybe_show_notification (NdQueue *queue)
                 return;
         }
 
-        stack = get_stack_with_pointer (queue);
-        list = nd_stack_get_bubbles (stack);
-        if (g_list_length (list) > 0) {
-                /* already showing bubbles */
-                g_debug ("Already showing bubbles");
+        pointer_stack = get_stack_with_pointer (queue);
+        full_stack = NULL;
+
+        show_held_summary (queue, pointer_stack);
+
+        for (l = queue->priv->queue->tail; l != NULL; l = prev) {
+                NdNotification *notification;
+                NdBubble       *bubble;
+                NdStack        *stack;
+                int             height;
+
+                prev = l->prev;
+
+                notification = g_hash_table_lookup (queue->priv->notifications, l->data);
+                g_assert (notification != NULL);
+
+                /* Mapping a bubble over a fullscreen window keeps the
+                   compositor from unredirecting it.  Held back entries
+                   stay queued, and critical ones behind them are still
+                   shown. */
+                stack = pointer_stack;
+                if (nd_notification_get_urgency (notification) != ND_NOTIFICATION_URGENCY_CRITICAL) {
+                        stack = get_stack_without_fullscreen (queue, pointer_stack);
+                        if (stack == NULL) {
+                                g_debug ("Holding back a notification over a fullscreen window");
+                                continue;
+                        }
+                }
+
+                /* Estimated from cached text heights, so a full stack
+                   costs no bubble or row on every update */
+                height = nd_stack_estimate_height (stack, notification);
+
+                /* The single surface fills up like a stack of bubbles,
+                   but has no room for the overflow bubble */
+                if (nd_stack_get_single_surface (stack)) {
+                        if (!nd_stack_has_room (stack, height)) {
+                                g_debug ("No room left on the surface");
+                                break;
+                        }
+
+                        g_queue_delete_link (queue->priv->queue, l);
+                        nd_stack_add_notification (stack, notification);
+                        continue;
+                }
+
+                if (!nd_stack_has_room (stack, height + get_overflow_reserve (queue, stack))) {
+                        g_debug ("No room left for bubbles");
+                        full_stack = stack;
+                        break;
+                }
+
+                g_queue_delete_link (queue->priv->queue, l);
+
+                bubble = nd_bubble_new_for_notification (notification);
+                g_signal_connect (bubble, "destroy", G_CALLBACK (on_bubble_destroyed), queue);
+                nd_stack_add_bubble (stack, bubble, TRUE);
+        }
+
+        update_overflow_bubble (queue, full_stack);
+}
+
+/* Takes everything but critical notifications out of the queue while
+ * inhibited, so they are only stored.  Transient ones are not meant to
+ * be stored and expire instead, as they would after being shown.
+ */
+static void
+hold_notifications (NdQueue *queue)
+{
+        GList *expired;
+        GList *l;
+        GList *next;
+
+        expired = NULL;
+
+        for (l = queue->priv->queue->head; l != NULL; l = next) {
+                NdNotification *notification;
+
+                next = l->next;
+
+                notification = g_hash_table_lookup (queue->priv->notifications, l->data);
+                if (nd_notification_get_urgency (notification) == ND_NOTIFICATION_URGENCY_CRITICAL)
+                        continue;
+
+                nd_notification_set_is_queued (notification, FALSE);
+
+                if (nd_notification_get_is_transient (notification)) {
+                        expired = g_list_prepend (expired, nd_notification_ref (notification));
+                } else {
+                        g_hash_table_add (queue->priv->held, l->data);
+                }
+
+                g_queue_delete_link (queue->priv->queue, l);
+        }
+
+        if (expired == NULL)
+                return;
+
+        nd_queue_freeze (queue);
+
+        for (l = expired; l != NULL; l = l->next) {
+                nd_notification_close (l->data, ND_NOTIFICATION_CLOSED_EXPIRED);
+        }
+
+        nd_queue_thaw (queue);
+
+        g_list_free_full (expired, (GDestroyNotify) nd_notification_unref);
+}
+
+static gboolean
+show_dock_idle (NdQueue *queue)
+{
+        show_dock (queue);
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Summaries are the only notifications without an id */
+static void
+on_summary_action_invoked (NdNotification *notification,
+                           const char     *action,
+                           gpointer        user_data)
+{
+        if (nd_notification_get_id (notification) != 0)
                 return;
+
+        /* Not from within the bubble's own event handler */
+        g_idle_add ((GSourceFunc) show_dock_idle, user_data);
+}
+
+/* A notification of the daemon itself, whose bubble opens the dock
+ * when clicked.
+ */
+static NdNotification *
+new_summary (NdQueue *queue)
+{
+        return nd_notification_new (NULL, 0);
+}
+
+static void
+update_summary (NdNotification *summary,
+                const char     *text,
+                int             timeout)
+{
+        const char *const actions[] = { NULL };
+        GHashTable       *hints;
+
+        hints = nd_notification_hints_new ();
+        g_hash_table_insert (hints,
+                             (gpointer) nd_string_pool_intern ("transient"),
+                             g_variant_ref_sink (g_variant_new_boolean (TRUE)));
+
+        nd_notification_update (summary,
+                                _("Notifications"),
+                                "mail-message-new",
+                                text,
+                                _("Click to show them."),
+                                actions,
+                                hints,
+                                timeout);
+
+        g_hash_table_unref (hints);
+}
+
+/* Sums up the notifications held back while inhibited in one bubble,
+ * which opens the dock with all of them when clicked.  It is shown
+ * from maybe_show_notification, once there is a place for it.
+ */
+static void
+add_held_summary (NdQueue *queue,
+                  guint    n_held)
+{
+        char *text;
+
+        queue->priv->n_summarized += n_held;
+
+        text = g_strdup_printf (ngettext ("%u notification arrived while notifications were paused",
+                                          "%u notifications arrived while notifications were paused",
+                                          queue->priv->n_summarized),
+                                queue->priv->n_summarized);
+
+        if (queue->priv->held_summary == NULL) {
+                queue->priv->held_summary = new_summary (queue);
         }
 
-        id = g_queue_pop_tail (queue->priv->queue);
-        if (id == NULL) {
-                /* Nothing to do */
-                g_debug ("No queued notifications");
+        update_summary (queue->priv->held_summary, text, -1);
+        g_free (text);
+}
+
+/* Held back like any other non-critical notification, over a
+ * fullscreen window or when the stack is full.
+ */
+static void
+show_held_summary (NdQueue *queue,
+                   NdStack *pointer_stack)
+{
+        NdNotification *summary;
+        NdStack        *stack;
+        int             height;
+
+        summary = queue->priv->held_summary;
+        if (summary == NULL || queue->priv->inhibited) {
                 return;
         }
 
-        notification = g_hash_table_lookup (queue->priv->notifications, id);
-        g_assert (notification != NULL);
+        stack = get_stack_without_fullscreen (queue, pointer_stack);
+        if (stack == NULL) {
+                g_debug ("Holding back the summary over a fullscreen window");
+                return;
+        }
+
+        height = nd_stack_estimate_height (stack, summary);
 
-        bubble = nd_bubble_new_for_notification (notification);
-        g_signal_connect (bubble, "destroy", G_CALLBACK (on_bubble_destroyed), queue);
+        if (nd_stack_get_single_surface (stack)) {
+                if (!nd_stack_has_room (stack, height)) {
+                        return;
+                }
+
+                nd_stack_add_notification (stack, summary);
+        } else {
+                NdBubble *bubble;
+
+                if (!nd_stack_has_room (stack, height + get_overflow_reserve (queue, stack))) {
+                        return;
+                }
+
+                bubble = nd_bubble_new_for_notification (summary);
+                g_signal_connect (bubble, "destroy", G_CALLBACK (on_bubble_destroyed), queue);
+                nd_stack_add_bubble (stack, bubble, TRUE);
+        }
 
-        nd_stack_add_bubble (stack, bubble, TRUE);
+        g_clear_pointer (&queue->priv->held_summary, nd_notification_unref);
+        queue->priv->n_summarized = 0;
 }
 
 static int
@@ -664,13 +1452,13 @@ update_dock (NdQueue *queue)
         GtkWidget   *child;
         GList       *list;
         GList       *l;
-        int          min_height;
         int          height;
         GdkMonitor  *monitor;
         GdkScreen   *screen;
         GdkRectangle area;
         GtkStatusIcon *status_icon;
         gboolean visible;
+        int          separator_height;
 
         g_return_if_fail (queue);
 
@@ -678,7 +1466,7 @@ update_dock (NdQueue *queue)
         if (child != NULL)
                 gtk_container_remove (GTK_CONTAINER (queue->priv->dock_scrolled_window), child);
 
-        child = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+        child = gtk_box_new (GTK_ORIENTATION_VERTICAL, DOCK_SPACING);
         gtk_container_add (GTK_CONTAINER (queue->priv->dock_scrolled_window),
                            child);
 
@@ -690,6 +1478,11 @@ update_dock (NdQueue *queue)
         list = g_hash_table_get_values (queue->priv->notifications);
         list = g_list_sort (list, (GCompareFunc)collate_notifications);
 
+        /* Rows are estimated from cached text heights instead of a
+           size negotiation of the whole list */
+        height = 0;
+        separator_height = -1;
+
         for (l = list; l != NULL; l = l->next) {
                 NdNotification    *n = l->data;
                 NdNotificationBox *box;
@@ -702,6 +1495,13 @@ update_dock (NdQueue *queue)
                 sep = gtk_separator_new (GTK_ORIENTATION_HORIZONTAL);
                 gtk_widget_show (sep);
                 gtk_box_pack_start (GTK_BOX (child), sep, FALSE, FALSE, 0);
+
+                if (separator_height < 0)
+                        gtk_widget_get_preferred_height (sep, NULL, &separator_height);
+
+                /* row, separator and the box spacing around it */
+                height += nd_notification_box_estimate_height (n)
+                        + separator_height + (DOCK_SPACING*2);
         }
         gtk_widget_show (child);
 
@@ -715,8 +1515,6 @@ update_dock (NdQueue *queue)
         }
 
         if (visible) {
-                gtk_widget_get_preferred_height (child, &min_height, &height);
-
                 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
                 gtk_status_icon_get_geometry (status_icon, &screen, &area, NULL);
                 G_GNUC_END_IGNORE_DEPRECATIONS
@@ -877,11 +1675,72 @@ on_status_icon_visible_notify (GtkStatusIcon *icon,
         }
 }
 
+/* Brings the stored notifications back under the memory budget, going
+ * through them in the order they are evicted in: lowest urgency first,
+ * oldest first within an urgency.  Notifications waiting for or showing
+ * a bubble are left alone.  Raw image data is dropped first, then low
+ * and normal urgency notifications are closed.
+ */
+static void
+enforce_memory_budget (NdQueue *queue)
+{
+        NdNotification *n;
+        NdNotification *next;
+        gsize           budget;
+
+        budget = queue->priv->memory_budget;
+        if (budget == 0 || queue->priv->memory_usage <= budget)
+                return;
+
+        for (n = nd_eviction_index_get_lowest (queue->priv->eviction_index);
+             n != NULL && queue->priv->memory_usage > budget;
+             n = nd_eviction_index_get_next (queue->priv->eviction_index, n)) {
+                if (nd_notification_get_is_queued (n))
+                        continue;
+
+                if (nd_notification_compact (n)) {
+                        update_memory_size (queue, n);
+                        queue->priv->n_compacted++;
+                }
+        }
+
+        for (n = nd_eviction_index_get_lowest (queue->priv->eviction_index);
+             n != NULL && queue->priv->memory_usage > budget;
+             n = next) {
+                if (nd_notification_get_urgency (n) == ND_NOTIFICATION_URGENCY_CRITICAL)
+                        break;
+
+                /* Closing removes it from the index */
+                next = nd_eviction_index_get_next (queue->priv->eviction_index, n);
+
+                if (nd_notification_get_is_queued (n))
+                        continue;
+
+                g_debug ("Closing id %u, over memory budget",
+                         nd_notification_get_id (n));
+
+                queue->priv->n_evicted++;
+                nd_notification_close (n, ND_NOTIFICATION_CLOSED_EXPIRED);
+        }
+}
+
 static gboolean
 update_idle (NdQueue *queue)
 {
         int num;
 
+        queue->priv->update_id = 0;
+
+        nd_watchdog_trace ("queue-update");
+
+        enforce_memory_budget (queue);
+
+        if (queue->priv->inhibited) {
+                /* Leaves nothing but critical notifications to show,
+                   the status icon still counts all of them */
+                hold_notifications (queue);
+        }
+
         num = g_hash_table_size (queue->priv->notifications);
 
         /* Show the status icon when their are stored notifications */
@@ -940,15 +1799,34 @@ update_idle (NdQueue *queue)
                         g_object_unref (queue->priv->status_icon);
                         queue->priv->status_icon = NULL;
                 }
+
+                /* Nothing left to sum up */
+                g_clear_pointer (&queue->priv->held_summary, nd_notification_unref);
+                queue->priv->n_summarized = 0;
         }
 
-        queue->priv->update_id = 0;
         return FALSE;
 }
 
+static void
+emit_changed (NdQueue *queue)
+{
+        if (queue->priv->freeze_count > 0) {
+                queue->priv->changed_pending = TRUE;
+                return;
+        }
+
+        g_signal_emit (queue, signals[CHANGED], 0);
+}
+
 static void
 queue_update (NdQueue *queue)
 {
+        if (queue->priv->freeze_count > 0) {
+                queue->priv->update_pending = TRUE;
+                return;
+        }
+
         if (queue->priv->update_id > 0) {
                 g_source_remove (queue->priv->update_id);
         }
@@ -967,15 +1845,17 @@ _nd_queue_remove (NdQueue        *queue,
 
         /* FIXME: withdraw currently showing bubbles */
 
-        g_signal_handlers_disconnect_by_func (notification, G_CALLBACK (on_notification_close), queue);
+        nd_eviction_index_remove (queue->priv->eviction_index, notification);
+        forget_memory_size (queue, notification);
 
         if (queue->priv->queue != NULL) {
                 g_queue_remove (queue->priv->queue, GUINT_TO_POINTER (id));
         }
+        g_hash_table_remove (queue->priv->held, GUINT_TO_POINTER (id));
         g_hash_table_remove (queue->priv->notifications, GUINT_TO_POINTER (id));
 
         /* FIXME: should probably only emit this when it really removes something */
-        g_signal_emit (queue, signals[CHANGED], 0);
+        emit_changed (queue);
 
         queue_update (queue);
 }
@@ -983,12 +1863,33 @@ _nd_queue_remove (NdQueue        *queue,
 static void
 on_notification_close (NdNotification *notification,
                        int             reason,
-                       NdQueue        *queue)
+                       gpointer        user_data)
 {
+        NdQueue *queue = ND_QUEUE (user_data);
+
+        if (!is_stored (queue, notification))
+                return;
+
         g_debug ("Notification closed - removing from queue");
         _nd_queue_remove (queue, notification);
 }
 
+/* Moves the notification to its new place in the eviction order, also
+ * for value-only updates, which refresh the update time as well.
+ */
+static void
+on_notification_changed (NdNotification *notification,
+                         gpointer        user_data)
+{
+        NdQueue *queue = ND_QUEUE (user_data);
+
+        if (!is_stored (queue, notification))
+                return;
+
+        nd_eviction_index_add (queue->priv->eviction_index, notification);
+        update_memory_size (queue, notification);
+}
+
 void
 nd_queue_remove_for_id (NdQueue *queue,
                         guint    id)
@@ -1013,17 +1914,165 @@ nd_queue_add (NdQueue        *queue,
 
         id = nd_notification_get_id (notification);
         g_debug ("Adding id %u", id);
-        g_hash_table_insert (queue->priv->notifications, GUINT_TO_POINTER (id), g_object_ref (notification));
-        g_queue_push_head (queue->priv->queue, GUINT_TO_POINTER (id));
 
-        g_signal_connect (notification, "closed", G_CALLBACK (on_notification_close), queue);
+        /* Updated notifications are added again once their bubble is gone */
+        if (g_hash_table_lookup (queue->priv->notifications, GUINT_TO_POINTER (id)) != notification) {
+                g_hash_table_insert (queue->priv->notifications, GUINT_TO_POINTER (id), nd_notification_ref (notification));
+        }
+
+        nd_eviction_index_add (queue->priv->eviction_index, notification);
+        update_memory_size (queue, notification);
+        g_queue_push_head (queue->priv->queue, GUINT_TO_POINTER (id));
 
         /* FIXME: should probably only emit this when it really adds something */
-        g_signal_emit (queue, signals[CHANGED], 0);
+        emit_changed (queue);
+
+        queue_update (queue);
+}
+
+/* Starts a transaction: until the matching nd_queue_thaw(), additions
+ * and removals are applied right away but ::changed and the relayout
+ * are held back, and then happen once for the whole transaction.
+ */
+void
+nd_queue_freeze (NdQueue *queue)
+{
+        g_return_if_fail (ND_IS_QUEUE (queue));
+
+        queue->priv->freeze_count++;
+}
+
+void
+nd_queue_thaw (NdQueue *queue)
+{
+        g_return_if_fail (ND_IS_QUEUE (queue));
+        g_return_if_fail (queue->priv->freeze_count > 0);
+
+        if (--queue->priv->freeze_count > 0) {
+                return;
+        }
+
+        if (queue->priv->changed_pending) {
+                queue->priv->changed_pending = FALSE;
+                emit_changed (queue);
+        }
+
+        if (queue->priv->update_pending) {
+                queue->priv->update_pending = FALSE;
+                queue_update (queue);
+        }
+}
+
+void
+nd_queue_set_memory_budget (NdQueue *queue,
+                            gsize    budget)
+{
+        g_return_if_fail (ND_IS_QUEUE (queue));
+
+        queue->priv->memory_budget = budget;
+        queue_update (queue);
+}
+
+void
+nd_queue_set_animate (NdQueue  *queue,
+                      gboolean  animate)
+{
+        NotifyScreen *nscreen;
+        int           i;
+
+        g_return_if_fail (ND_IS_QUEUE (queue));
+
+        queue->priv->animate = animate;
+
+        nscreen = queue->priv->screen;
+        for (i = 0; i < nscreen->n_stacks; i++) {
+                nd_stack_set_animate (nscreen->stacks[i], animate);
+        }
+}
+
+void
+nd_queue_set_single_surface (NdQueue  *queue,
+                             gboolean  single_surface)
+{
+        NotifyScreen *nscreen;
+        int           i;
+
+        g_return_if_fail (ND_IS_QUEUE (queue));
+
+        queue->priv->single_surface = single_surface;
+
+        nscreen = queue->priv->screen;
+        for (i = 0; i < nscreen->n_stacks; i++) {
+                nd_stack_set_single_surface (nscreen->stacks[i], single_surface);
+        }
+}
+
+/* While inhibited notifications are stored but not shown, apart from
+ * critical ones.  Once that ends, a single held notification is
+ * queued again, more than that are summed up in one bubble.
+ */
+void
+nd_queue_set_inhibited (NdQueue  *queue,
+                        gboolean  inhibited)
+{
+        guint n_held;
+
+        g_return_if_fail (ND_IS_QUEUE (queue));
+
+        if (queue->priv->inhibited == inhibited) {
+                return;
+        }
+
+        queue->priv->inhibited = inhibited;
+        g_debug ("Notifications %s", inhibited ? "inhibited" : "uninhibited");
+
+        n_held = g_hash_table_size (queue->priv->held);
+        if (!inhibited && n_held == 1) {
+                GHashTableIter  iter;
+                gpointer        id;
+                NdNotification *notification;
+
+                g_hash_table_iter_init (&iter, queue->priv->held);
+                g_hash_table_iter_next (&iter, &id, NULL);
+
+                notification = g_hash_table_lookup (queue->priv->notifications, id);
+                if (!nd_notification_get_is_queued (notification)) {
+                        nd_notification_set_is_queued (notification, TRUE);
+                        g_queue_push_head (queue->priv->queue, id);
+                }
+        } else if (!inhibited && n_held > 1) {
+                add_held_summary (queue, n_held);
+        }
+
+        if (!inhibited) {
+                g_hash_table_remove_all (queue->priv->held);
+        }
 
         queue_update (queue);
 }
 
+void
+nd_queue_add_statistics (NdQueue         *queue,
+                         GVariantBuilder *builder)
+{
+        g_return_if_fail (ND_IS_QUEUE (queue));
+
+        g_variant_builder_add (builder, "{sv}", "notifications",
+                               g_variant_new_uint32 (g_hash_table_size (queue->priv->notifications)));
+        g_variant_builder_add (builder, "{sv}", "memory-usage",
+                               g_variant_new_uint64 (queue->priv->memory_usage));
+        g_variant_builder_add (builder, "{sv}", "memory-budget",
+                               g_variant_new_uint64 (queue->priv->memory_budget));
+        g_variant_builder_add (builder, "{sv}", "memory-compacted",
+                               g_variant_new_uint32 (queue->priv->n_compacted));
+        g_variant_builder_add (builder, "{sv}", "memory-evicted",
+                               g_variant_new_uint32 (queue->priv->n_evicted));
+        g_variant_builder_add (builder, "{sv}", "held",
+                               g_variant_new_uint32 (g_hash_table_size (queue->priv->held)));
+        g_variant_builder_add (builder, "{sv}", "stale-dropped",
+                               g_variant_new_uint32 (queue->priv->n_stale));
+}
+
 NdQueue *
 nd_queue_new (void)
 {
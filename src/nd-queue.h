@@ -58,11 +58,29 @@ guint               nd_queue_length                         (NdQueue        *que
 NdNotification *    nd_queue_lookup                         (NdQueue        *queue,
                                                              guint           id);
 
+NdNotification *    nd_queue_get_lowest_urgency             (NdQueue        *queue);
+NdNotification *    nd_queue_get_oldest_from                (NdQueue        *queue,
+                                                             const char     *sender);
+
 void                nd_queue_add                            (NdQueue        *queue,
                                                              NdNotification *notification);
 void                nd_queue_remove_for_id                  (NdQueue        *queue,
                                                              guint           id);
 
+void                nd_queue_freeze                         (NdQueue        *queue);
+void                nd_queue_thaw                           (NdQueue        *queue);
+
+void                nd_queue_set_memory_budget              (NdQueue        *queue,
+                                                             gsize           budget);
+void                nd_queue_set_animate                    (NdQueue        *queue,
+                                                             gboolean        animate);
+void                nd_queue_set_single_surface             (NdQueue        *queue,
+                                                             gboolean        single_surface);
+void                nd_queue_set_inhibited                  (NdQueue        *queue,
+                                                             gboolean        inhibited);
+void                nd_queue_add_statistics                 (NdQueue         *queue,
+                                                             GVariantBuilder *builder);
+
 G_END_DECLS
 
 #endif /* __ND_QUEUE_H */
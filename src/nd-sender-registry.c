@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "nd-sender-registry.h"
+#include "nd-string-pool.h"
+
+/*
+ * Keeps one bus name watch per sender that has live notifications,
+ * together with the set of those notifications.  The watch goes away
+ * with the last notification, and ::sender-vanished is emitted when
+ * the sender drops off the bus while it still has some.
+ */
+
+typedef struct
+{
+  NdSenderRegistry *registry;
+  const gchar      *name;
+  guint             watch_id;
+
+  /* id -> NdNotification, not referenced */
+  GHashTable       *notifications;
+} Sender;
+
+struct _NdSenderRegistry
+{
+  GObject     parent;
+
+  GHashTable *senders;
+};
+
+enum
+{
+  SENDER_VANISHED,
+
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (NdSenderRegistry, nd_sender_registry, G_TYPE_OBJECT)
+
+static void
+sender_free (gpointer data)
+{
+  Sender *sender;
+
+  sender = data;
+
+  g_bus_unwatch_name (sender->watch_id);
+  g_hash_table_destroy (sender->notifications);
+  nd_string_pool_release (sender->name);
+
+  g_slice_free (Sender, sender);
+}
+
+static void
+name_vanished_cb (GDBusConnection *connection,
+                  const gchar     *name,
+                  gpointer         user_data)
+{
+  Sender *sender;
+  NdSenderRegistry *registry;
+
+  sender = user_data;
+  registry = sender->registry;
+
+  if (g_hash_table_size (sender->notifications) == 0)
+    return;
+
+  g_debug ("Sender %s vanished with %u notifications", name,
+           g_hash_table_size (sender->notifications));
+
+  g_object_ref (registry);
+  g_signal_emit (registry, signals[SENDER_VANISHED], 0, name);
+  g_object_unref (registry);
+}
+
+static void
+nd_sender_registry_finalize (GObject *object)
+{
+  NdSenderRegistry *registry;
+
+  registry = ND_SENDER_REGISTRY (object);
+
+  g_hash_table_destroy (registry->senders);
+
+  G_OBJECT_CLASS (nd_sender_registry_parent_class)->finalize (object);
+}
+
+static void
+nd_sender_registry_class_init (NdSenderRegistryClass *registry_class)
+{
+  GObjectClass *object_class;
+
+  object_class = G_OBJECT_CLASS (registry_class);
+
+  object_class->finalize = nd_sender_registry_finalize;
+
+  signals[SENDER_VANISHED] =
+    g_signal_new ("sender-vanished", G_TYPE_FROM_CLASS (registry_class),
+                  G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                  G_TYPE_NONE, 1, G_TYPE_STRING);
+}
+
+static void
+nd_sender_registry_init (NdSenderRegistry *registry)
+{
+  registry->senders = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             NULL, sender_free);
+}
+
+NdSenderRegistry *
+nd_sender_registry_new (void)
+{
+  return g_object_new (ND_TYPE_SENDER_REGISTRY, NULL);
+}
+
+void
+nd_sender_registry_add (NdSenderRegistry *registry,
+                        NdNotification   *notification)
+{
+  const gchar *name;
+  Sender *sender;
+
+  name = nd_notification_get_sender (notification);
+  if (name == NULL)
+    return;
+
+  sender = g_hash_table_lookup (registry->senders, name);
+
+  if (sender == NULL)
+    {
+      sender = g_slice_new0 (Sender);
+      sender->registry = registry;
+      sender->name = nd_string_pool_intern (name);
+      sender->notifications = g_hash_table_new (NULL, NULL);
+
+      g_hash_table_insert (registry->senders, (gpointer) sender->name, sender);
+
+      /* Also reports a sender that is already gone by now. */
+      sender->watch_id = g_bus_watch_name (G_BUS_TYPE_SESSION, name,
+                                           G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                           NULL, name_vanished_cb,
+                                           sender, NULL);
+    }
+
+  g_hash_table_insert (sender->notifications,
+                       GUINT_TO_POINTER (nd_notification_get_id (notification)),
+                       notification);
+}
+
+void
+nd_sender_registry_remove (NdSenderRegistry *registry,
+                           NdNotification   *notification)
+{
+  const gchar *name;
+  Sender *sender;
+
+  name = nd_notification_get_sender (notification);
+  if (name == NULL)
+    return;
+
+  sender = g_hash_table_lookup (registry->senders, name);
+  if (sender == NULL)
+    return;
+
+  g_hash_table_remove (sender->notifications,
+                       GUINT_TO_POINTER (nd_notification_get_id (notification)));
+
+  if (g_hash_table_size (sender->notifications) == 0)
+    g_hash_table_remove (registry->senders, name);
+}
+
+/* Returns the live notifications of @sender.  Free the list with
+ * g_list_free(), the notifications are not referenced.
+ */
+GList *
+nd_sender_registry_get_notifications (NdSenderRegistry *registry,
+                                      const gchar      *sender)
+{
+  Sender *entry;
+
+  entry = g_hash_table_lookup (registry->senders, sender);
+  if (entry == NULL)
+    return NULL;
+
+  return g_hash_table_get_values (entry->notifications);
+}
+
+guint
+nd_sender_registry_get_n_senders (NdSenderRegistry *registry)
+{
+  return g_hash_table_size (registry->senders);
+}
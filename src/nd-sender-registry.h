@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ND_SENDER_REGISTRY_H
+#define ND_SENDER_REGISTRY_H
+
+#include "nd-notification.h"
+
+G_BEGIN_DECLS
+
+#define ND_TYPE_SENDER_REGISTRY nd_sender_registry_get_type ()
+G_DECLARE_FINAL_TYPE (NdSenderRegistry, nd_sender_registry,
+                      ND, SENDER_REGISTRY, GObject)
+
+NdSenderRegistry *nd_sender_registry_new               (void);
+
+void              nd_sender_registry_add               (NdSenderRegistry *registry,
+                                                        NdNotification   *notification);
+void              nd_sender_registry_remove            (NdSenderRegistry *registry,
+                                                        NdNotification   *notification);
+
+GList            *nd_sender_registry_get_notifications (NdSenderRegistry *registry,
+                                                        const gchar      *sender);
+guint             nd_sender_registry_get_n_senders     (NdSenderRegistry *registry);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "nd-socket-listener.h"
+
+/*
+ * A Unix socket for clients that post notifications faster than
+ * D-Bus method calls allow.  Each frame is a 32-bit big-endian length
+ * followed by a little-endian serialized GVariant, and frames are
+ * never answered, so clients can pipeline as many as they like.
+ *
+ * A client is read one frame at a time.  Every frame handed out can
+ * be held until it has been applied; once MAX_IN_FLIGHT frames of a
+ * client are held its socket is no longer read, until enough of them
+ * have been released again.
+ *
+ * Only peers running as the same user are accepted.  Everything but
+ * nd_socket_client_release() runs in the main context the listener
+ * was started in.
+ */
+
+#define MAX_FRAME_SIZE (256 * 1024)
+#define MAX_IN_FLIGHT 256
+#define RESUME_IN_FLIGHT (MAX_IN_FLIGHT / 4)
+
+struct _NdSocketClient
+{
+  gint                ref_count;
+  gint                in_flight;
+
+  NdSocketListener   *listener;
+  GMainContext       *context;
+  GSocketConnection  *connection;
+  GCancellable       *cancellable;
+
+  const GVariantType *frame_type;
+  NdSocketFrameFunc   func;
+  gpointer            user_data;
+
+  guint32             header;
+  guint8             *payload;
+  gsize               payload_size;
+
+  gboolean            paused;
+  gboolean            closed;
+};
+
+struct _NdSocketListener
+{
+  GObject             parent;
+
+  GVariantType       *frame_type;
+  NdSocketFrameFunc   func;
+  gpointer            user_data;
+
+  GSocketService     *service;
+  gchar              *path;
+
+  GList              *clients;
+};
+
+G_DEFINE_TYPE (NdSocketListener, nd_socket_listener, G_TYPE_OBJECT)
+
+static void read_header (NdSocketClient *client);
+
+static NdSocketClient *
+client_ref (NdSocketClient *client)
+{
+  g_atomic_int_inc (&client->ref_count);
+
+  return client;
+}
+
+static void
+client_unref (NdSocketClient *client)
+{
+  if (!g_atomic_int_dec_and_test (&client->ref_count))
+    return;
+
+  g_object_unref (client->connection);
+  g_object_unref (client->cancellable);
+  g_main_context_unref (client->context);
+  g_free (client->payload);
+
+  g_slice_free (NdSocketClient, client);
+}
+
+static void
+client_close (NdSocketClient *client)
+{
+  NdSocketListener *listener;
+
+  if (client->closed)
+    return;
+
+  client->closed = TRUE;
+  g_io_stream_close (G_IO_STREAM (client->connection), NULL, NULL);
+
+  listener = client->listener;
+  if (listener != NULL)
+    {
+      listener->clients = g_list_remove (listener->clients, client);
+      client->listener = NULL;
+      client_unref (client);
+    }
+}
+
+static gboolean
+finish_read (NdSocketClient *client,
+             GObject        *source,
+             GAsyncResult   *result,
+             gsize           expected)
+{
+  GError *error;
+  gsize n_read;
+
+  error = NULL;
+  if (!g_input_stream_read_all_finish (G_INPUT_STREAM (source), result,
+                                       &n_read, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_debug ("Failed to read from socket client: %s", error->message);
+
+      g_error_free (error);
+      client_close (client);
+
+      return FALSE;
+    }
+
+  /* End of stream */
+  if (n_read < expected)
+    {
+      client_close (client);
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+payload_cb (GObject      *source,
+            GAsyncResult *result,
+            gpointer      user_data)
+{
+  NdSocketClient *client;
+  GBytes *bytes;
+  GVariant *frame;
+
+  client = user_data;
+
+  if (!finish_read (client, source, result, client->payload_size))
+    {
+      client_unref (client);
+      return;
+    }
+
+  bytes = g_bytes_new_take (g_steal_pointer (&client->payload),
+                            client->payload_size);
+  frame = g_variant_ref_sink (g_variant_new_from_bytes (client->frame_type,
+                                                        bytes, FALSE));
+  g_bytes_unref (bytes);
+
+  if (G_BYTE_ORDER == G_BIG_ENDIAN)
+    {
+      GVariant *swapped;
+
+      swapped = g_variant_byteswap (frame);
+      g_variant_unref (frame);
+      frame = swapped;
+    }
+
+  client->func (client, frame, client->user_data);
+  g_variant_unref (frame);
+
+  if (g_atomic_int_get (&client->in_flight) >= MAX_IN_FLIGHT)
+    client->paused = TRUE;
+  else
+    read_header (client);
+
+  client_unref (client);
+}
+
+static void
+header_cb (GObject      *source,
+           GAsyncResult *result,
+           gpointer      user_data)
+{
+  NdSocketClient *client;
+  guint32 size;
+
+  client = user_data;
+
+  if (!finish_read (client, source, result, sizeof (client->header)))
+    {
+      client_unref (client);
+      return;
+    }
+
+  size = GUINT32_FROM_BE (client->header);
+  if (size == 0 || size > MAX_FRAME_SIZE)
+    {
+      g_debug ("Dropping socket client that sent a frame of %u bytes", size);
+
+      client_close (client);
+      client_unref (client);
+
+      return;
+    }
+
+  client->payload = g_malloc (size);
+  client->payload_size = size;
+
+  g_input_stream_read_all_async (g_io_stream_get_input_stream (G_IO_STREAM (client->connection)),
+                                 client->payload, client->payload_size,
+                                 G_PRIORITY_DEFAULT, client->cancellable,
+                                 payload_cb, client);
+}
+
+static void
+read_header (NdSocketClient *client)
+{
+  g_input_stream_read_all_async (g_io_stream_get_input_stream (G_IO_STREAM (client->connection)),
+                                 &client->header, sizeof (client->header),
+                                 G_PRIORITY_DEFAULT, client->cancellable,
+                                 header_cb, client_ref (client));
+}
+
+static gboolean
+resume_cb (gpointer user_data)
+{
+  NdSocketClient *client;
+
+  client = user_data;
+
+  if (client->paused && !client->closed &&
+      g_atomic_int_get (&client->in_flight) <= RESUME_IN_FLIGHT)
+    {
+      client->paused = FALSE;
+      read_header (client);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+incoming_cb (GSocketService    *service,
+             GSocketConnection *connection,
+             GObject           *source_object,
+             gpointer           user_data)
+{
+  NdSocketListener *listener;
+  GCredentials *credentials;
+  NdSocketClient *client;
+  GError *error;
+
+  listener = ND_SOCKET_LISTENER (user_data);
+
+  /* SO_PEERCRED on Linux */
+  error = NULL;
+  credentials = g_socket_get_credentials (g_socket_connection_get_socket (connection),
+                                          &error);
+
+  if (credentials == NULL)
+    {
+      g_debug ("Rejecting socket client: %s", error->message);
+      g_error_free (error);
+
+      return TRUE;
+    }
+
+  if (g_credentials_get_unix_user (credentials, NULL) != getuid ())
+    {
+      g_debug ("Rejecting socket client of another user");
+      g_object_unref (credentials);
+
+      return TRUE;
+    }
+
+  g_object_unref (credentials);
+
+  client = g_slice_new0 (NdSocketClient);
+  client->ref_count = 1;
+  client->listener = listener;
+  client->context = g_main_context_ref_thread_default ();
+  client->connection = g_object_ref (connection);
+  client->cancellable = g_cancellable_new ();
+  client->frame_type = listener->frame_type;
+  client->func = listener->func;
+  client->user_data = listener->user_data;
+
+  /* The listener's reference */
+  listener->clients = g_list_prepend (listener->clients, client);
+
+  read_header (client);
+
+  return TRUE;
+}
+
+static void
+nd_socket_listener_dispose (GObject *object)
+{
+  NdSocketListener *listener;
+  GList *l;
+
+  listener = ND_SOCKET_LISTENER (object);
+
+  for (l = listener->clients; l != NULL; l = l->next)
+    {
+      NdSocketClient *client;
+
+      client = l->data;
+      client->listener = NULL;
+      g_cancellable_cancel (client->cancellable);
+      client_unref (client);
+    }
+
+  g_clear_pointer (&listener->clients, g_list_free);
+
+  if (listener->service != NULL)
+    {
+      g_socket_service_stop (listener->service);
+      g_socket_listener_close (G_SOCKET_LISTENER (listener->service));
+      g_clear_object (&listener->service);
+    }
+
+  if (listener->path != NULL)
+    {
+      g_unlink (listener->path);
+      g_clear_pointer (&listener->path, g_free);
+    }
+
+  G_OBJECT_CLASS (nd_socket_listener_parent_class)->dispose (object);
+}
+
+static void
+nd_socket_listener_finalize (GObject *object)
+{
+  NdSocketListener *listener;
+
+  listener = ND_SOCKET_LISTENER (object);
+
+  g_variant_type_free (listener->frame_type);
+
+  G_OBJECT_CLASS (nd_socket_listener_parent_class)->finalize (object);
+}
+
+static void
+nd_socket_listener_class_init (NdSocketListenerClass *listener_class)
+{
+  GObjectClass *object_class;
+
+  object_class = G_OBJECT_CLASS (listener_class);
+
+  object_class->dispose = nd_socket_listener_dispose;
+  object_class->finalize = nd_socket_listener_finalize;
+}
+
+static void
+nd_socket_listener_init (NdSocketListener *listener)
+{
+}
+
+/* @func gets every frame of type @frame_type, on the main context the
+ * listener is started in.
+ */
+NdSocketListener *
+nd_socket_listener_new (const GVariantType *frame_type,
+                        NdSocketFrameFunc   func,
+                        gpointer            user_data)
+{
+  NdSocketListener *listener;
+
+  listener = g_object_new (ND_TYPE_SOCKET_LISTENER, NULL);
+  listener->frame_type = g_variant_type_copy (frame_type);
+  listener->func = func;
+  listener->user_data = user_data;
+
+  return listener;
+}
+
+/* Starts accepting clients on @path, in the thread-default main
+ * context.  A socket left behind at @path is replaced.
+ */
+gboolean
+nd_socket_listener_listen (NdSocketListener  *listener,
+                           const gchar       *path,
+                           GError           **error)
+{
+  GSocketAddress *address;
+  GStatBuf st;
+  gboolean added;
+
+  g_return_val_if_fail (ND_IS_SOCKET_LISTENER (listener), FALSE);
+  g_return_val_if_fail (listener->service == NULL, FALSE);
+
+  if (g_lstat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+    g_unlink (path);
+
+  listener->service = g_socket_service_new ();
+
+  address = g_unix_socket_address_new (path);
+  added = g_socket_listener_add_address (G_SOCKET_LISTENER (listener->service),
+                                         address, G_SOCKET_TYPE_STREAM,
+                                         G_SOCKET_PROTOCOL_DEFAULT,
+                                         NULL, NULL, error);
+  g_object_unref (address);
+
+  if (!added)
+    {
+      g_clear_object (&listener->service);
+
+      return FALSE;
+    }
+
+  g_chmod (path, 0600);
+  listener->path = g_strdup (path);
+
+  g_signal_connect (listener->service, "incoming",
+                    G_CALLBACK (incoming_cb), listener);
+  g_socket_service_start (listener->service);
+
+  return TRUE;
+}
+
+/* Marks a frame of @client as in flight, until it is passed to
+ * nd_socket_client_release().  Returns @client.
+ */
+NdSocketClient *
+nd_socket_client_hold (NdSocketClient *client)
+{
+  g_atomic_int_inc (&client->in_flight);
+
+  return client_ref (client);
+}
+
+/* Can be called from any thread. */
+void
+nd_socket_client_release (NdSocketClient *client)
+{
+  if (g_atomic_int_add (&client->in_flight, -1) == RESUME_IN_FLIGHT + 1)
+    g_main_context_invoke_full (client->context, G_PRIORITY_DEFAULT,
+                                resume_cb, client_ref (client),
+                                (GDestroyNotify) client_unref);
+
+  client_unref (client);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ND_SOCKET_LISTENER_H
+#define ND_SOCKET_LISTENER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _NdSocketClient NdSocketClient;
+
+typedef void (* NdSocketFrameFunc) (NdSocketClient *client,
+                                    GVariant       *frame,
+                                    gpointer        user_data);
+
+#define ND_TYPE_SOCKET_LISTENER nd_socket_listener_get_type ()
+G_DECLARE_FINAL_TYPE (NdSocketListener, nd_socket_listener,
+                      ND, SOCKET_LISTENER, GObject)
+
+NdSocketListener *nd_socket_listener_new     (const GVariantType *frame_type,
+                                              NdSocketFrameFunc   func,
+                                              gpointer            user_data);
+
+gboolean          nd_socket_listener_listen  (NdSocketListener   *listener,
+                                              const gchar        *path,
+                                              GError            **error);
+
+NdSocketClient   *nd_socket_client_hold      (NdSocketClient     *client);
+void              nd_socket_client_release   (NdSocketClient     *client);
+
+G_END_DECLS
+
+#endif
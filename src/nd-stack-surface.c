@@ -0,0 +1,498 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "nd-layout-cache.h"
+#include "nd-notification-box.h"
+#include "nd-stack-surface.h"
+
+/* A single transparent popup that draws every visible notification
+ * of a stack, as an alternative to one NdBubble window each.  Rows
+ * are dock notification boxes; the input region is limited to them,
+ * so the gaps between rows stay click-through.
+ */
+
+#define EXPIRATION_TIME_DEFAULT -1
+#define EXPIRATION_TIME_NEVER_EXPIRES 0
+#define TIMEOUT_SEC   5
+
+#define WIDTH         ND_LAYOUT_WIDTH
+#define ROW_SPACING   6
+#define ROW_PADDING   4
+#define ROW_RADIUS    8
+#define BACKGROUND_ALPHA    0.90
+
+typedef struct
+{
+        NdStackSurface *surface;
+        NdNotification *notification;
+        GtkWidget      *box;
+        guint           timeout_id;
+
+        /* The expiry is paused while the pointer is over the row */
+        gboolean        hovered;
+} SurfaceRow;
+
+struct NdStackSurfacePrivate
+{
+        GtkWidget      *rows_box;
+        GList          *rows;
+        gboolean        composited;
+};
+
+enum {
+        NOTIFICATION_HIDDEN,
+        LAST_SIGNAL
+};
+
+static guint signals [LAST_SIGNAL] = { 0, };
+
+static void     remove_row              (SurfaceRow     *row);
+
+G_DEFINE_TYPE_WITH_PRIVATE (NdStackSurface, nd_stack_surface, GTK_TYPE_WINDOW)
+
+static gboolean
+row_timeout_cb (SurfaceRow *row)
+{
+        row->timeout_id = 0;
+
+        remove_row (row);
+
+        return FALSE;
+}
+
+static void
+add_row_timeout (SurfaceRow *row)
+{
+        int timeout = nd_notification_get_timeout (row->notification);
+
+        if (row->timeout_id != 0) {
+                g_source_remove (row->timeout_id);
+                row->timeout_id = 0;
+        }
+
+        if (timeout == EXPIRATION_TIME_NEVER_EXPIRES || row->hovered)
+                return;
+
+        if (timeout == EXPIRATION_TIME_DEFAULT)
+                timeout = TIMEOUT_SEC * 1000;
+
+        row->timeout_id = g_timeout_add (timeout,
+                                         (GSourceFunc) row_timeout_cb,
+                                         row);
+}
+
+static void
+on_row_notification_changed (GObject    *binding,
+                             SurfaceRow *row)
+{
+        add_row_timeout (row);
+}
+
+static void
+on_row_notification_closed (GObject    *binding,
+                            int         reason,
+                            SurfaceRow *row)
+{
+        remove_row (row);
+}
+
+static void
+on_row_action_invoked (GObject    *binding,
+                       const char *action,
+                       SurfaceRow *row)
+{
+        if (nd_notification_get_is_transient (row->notification)
+            || !nd_notification_get_is_resident (row->notification)) {
+                remove_row (row);
+        }
+}
+
+/* Crossings into and out of the widgets of a row are reported as
+   GDK_NOTIFY_INFERIOR and do not change the hover state */
+static gboolean
+on_row_enter_notify (GtkWidget        *widget,
+                     GdkEventCrossing *event,
+                     SurfaceRow       *row)
+{
+        if (event->detail == GDK_NOTIFY_INFERIOR || row->hovered)
+                return FALSE;
+
+        row->hovered = TRUE;
+        add_row_timeout (row);
+
+        return FALSE;
+}
+
+static gboolean
+on_row_leave_notify (GtkWidget        *widget,
+                     GdkEventCrossing *event,
+                     SurfaceRow       *row)
+{
+        if (event->detail == GDK_NOTIFY_INFERIOR || !row->hovered)
+                return FALSE;
+
+        row->hovered = FALSE;
+        add_row_timeout (row);
+
+        return FALSE;
+}
+
+static void
+remove_row (SurfaceRow *row)
+{
+        NdStackSurface *surface;
+        NdNotification *notification;
+
+        surface = row->surface;
+        notification = row->notification;
+
+        surface->priv->rows = g_list_remove (surface->priv->rows, row);
+
+        if (row->timeout_id != 0) {
+                g_source_remove (row->timeout_id);
+        }
+
+        nd_notification_unbind (notification, row);
+        gtk_widget_destroy (row->box);
+        g_slice_free (SurfaceRow, row);
+
+        if (surface->priv->rows == NULL) {
+                gtk_widget_hide (GTK_WIDGET (surface));
+        }
+
+        g_signal_emit (surface, signals[NOTIFICATION_HIDDEN], 0, notification);
+        nd_notification_unref (notification);
+}
+
+static void
+rounded_rectangle (cairo_t      *cr,
+                   GdkRectangle *rect,
+                   double        radius)
+{
+        double x = rect->x;
+        double y = rect->y;
+        double w = rect->width;
+        double h = rect->height;
+
+        cairo_new_sub_path (cr);
+        cairo_arc (cr, x + w - radius, y + radius, radius, -G_PI / 2, 0);
+        cairo_arc (cr, x + w - radius, y + h - radius, radius, 0, G_PI / 2);
+        cairo_arc (cr, x + radius, y + h - radius, radius, G_PI / 2, G_PI);
+        cairo_arc (cr, x + radius, y + radius, radius, G_PI, 3 * G_PI / 2);
+        cairo_close_path (cr);
+}
+
+static void
+get_row_rectangle (SurfaceRow   *row,
+                   GdkRectangle *rect)
+{
+        gtk_widget_get_allocation (row->box, rect);
+
+        rect->x -= ROW_PADDING;
+        rect->y -= ROW_PADDING;
+        rect->width += ROW_PADDING * 2;
+        rect->height += ROW_PADDING * 2;
+}
+
+static gboolean
+nd_stack_surface_draw (GtkWidget *widget,
+                       cairo_t   *cr)
+{
+        NdStackSurface  *surface = ND_STACK_SURFACE (widget);
+        GtkStyleContext *context;
+        GdkRGBA         *bg;
+        GdkRGBA          fg;
+        GList           *l;
+
+        context = gtk_widget_get_style_context (widget);
+        gtk_style_context_get (context, GTK_STATE_FLAG_NORMAL,
+                               "background-color", &bg,
+                               NULL);
+        gtk_style_context_get_color (context, GTK_STATE_FLAG_NORMAL, &fg);
+
+        cairo_save (cr);
+        cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, 0.0);
+        cairo_paint (cr);
+        cairo_restore (cr);
+
+        for (l = surface->priv->rows; l != NULL; l = l->next) {
+                GdkRectangle rect;
+
+                get_row_rectangle (l->data, &rect);
+                rounded_rectangle (cr, &rect, ROW_RADIUS);
+
+                cairo_set_source_rgba (cr, bg->red, bg->green, bg->blue,
+                                       surface->priv->composited ? BACKGROUND_ALPHA : 1.0);
+                cairo_fill_preserve (cr);
+
+                cairo_set_source_rgba (cr, fg.red, fg.green, fg.blue,
+                                       BACKGROUND_ALPHA / 2);
+                cairo_set_line_width (cr, 2);
+                cairo_stroke (cr);
+        }
+
+        gdk_rgba_free (bg);
+
+        GTK_WIDGET_CLASS (nd_stack_surface_parent_class)->draw (widget, cr);
+
+        return FALSE;
+}
+
+/* Only the rows take input, and without a compositor they are also
+ * the only part of the window that is shown.
+ */
+static void
+update_shape (NdStackSurface *surface)
+{
+        cairo_region_t *region;
+        GList          *l;
+
+        region = cairo_region_create ();
+
+        for (l = surface->priv->rows; l != NULL; l = l->next) {
+                GdkRectangle rect;
+
+                get_row_rectangle (l->data, &rect);
+                cairo_region_union_rectangle (region, &rect);
+        }
+
+        gtk_widget_input_shape_combine_region (GTK_WIDGET (surface), region);
+
+        if (surface->priv->composited) {
+                gtk_widget_shape_combine_region (GTK_WIDGET (surface), NULL);
+        } else {
+                gtk_widget_shape_combine_region (GTK_WIDGET (surface), region);
+        }
+
+        cairo_region_destroy (region);
+}
+
+static void
+nd_stack_surface_size_allocate (GtkWidget     *widget,
+                                GtkAllocation *allocation)
+{
+        GTK_WIDGET_CLASS (nd_stack_surface_parent_class)->size_allocate (widget, allocation);
+
+        update_shape (ND_STACK_SURFACE (widget));
+}
+
+static void
+nd_stack_surface_get_preferred_width (GtkWidget *widget,
+                                      gint      *min_width,
+                                      gint      *nat_width)
+{
+        if (min_width != NULL)
+                *min_width = WIDTH;
+        if (nat_width != NULL)
+                *nat_width = WIDTH;
+}
+
+static void
+nd_stack_surface_composited_changed (GtkWidget *widget)
+{
+        NdStackSurface *surface = ND_STACK_SURFACE (widget);
+
+        surface->priv->composited = gdk_screen_is_composited (gtk_widget_get_screen (widget));
+
+        update_shape (surface);
+        gtk_widget_queue_draw (widget);
+}
+
+static void
+nd_stack_surface_finalize (GObject *object)
+{
+        NdStackSurface *surface = ND_STACK_SURFACE (object);
+
+        g_warn_if_fail (surface->priv->rows == NULL);
+
+        G_OBJECT_CLASS (nd_stack_surface_parent_class)->finalize (object);
+}
+
+static void
+nd_stack_surface_destroy (GtkWidget *widget)
+{
+        nd_stack_surface_remove_all (ND_STACK_SURFACE (widget));
+
+        GTK_WIDGET_CLASS (nd_stack_surface_parent_class)->destroy (widget);
+}
+
+static void
+nd_stack_surface_class_init (NdStackSurfaceClass *klass)
+{
+        GObjectClass   *object_class = G_OBJECT_CLASS (klass);
+        GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+        object_class->finalize = nd_stack_surface_finalize;
+        widget_class->destroy = nd_stack_surface_destroy;
+        widget_class->draw = nd_stack_surface_draw;
+        widget_class->size_allocate = nd_stack_surface_size_allocate;
+        widget_class->get_preferred_width = nd_stack_surface_get_preferred_width;
+        widget_class->composited_changed = nd_stack_surface_composited_changed;
+
+        signals[NOTIFICATION_HIDDEN] =
+                g_signal_new ("notification-hidden",
+                              G_TYPE_FROM_CLASS (klass),
+                              G_SIGNAL_RUN_LAST,
+                              G_STRUCT_OFFSET (NdStackSurfaceClass, notification_hidden),
+                              NULL, NULL,
+                              g_cclosure_marshal_VOID__BOXED,
+                              G_TYPE_NONE, 1, ND_TYPE_NOTIFICATION);
+}
+
+static void
+nd_stack_surface_init (NdStackSurface *surface)
+{
+        GdkScreen *screen;
+        GdkVisual *visual;
+
+        surface->priv = nd_stack_surface_get_instance_private (surface);
+
+        screen = gtk_window_get_screen (GTK_WINDOW (surface));
+        visual = gdk_screen_get_rgba_visual (screen);
+        if (visual == NULL) {
+                visual = gdk_screen_get_system_visual (screen);
+        }
+
+        gtk_widget_set_visual (GTK_WIDGET (surface), visual);
+        surface->priv->composited = gdk_screen_is_composited (screen);
+
+        atk_object_set_role (gtk_widget_get_accessible (GTK_WIDGET (surface)), ATK_ROLE_ALERT);
+
+        surface->priv->rows_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, ROW_SPACING + ROW_PADDING * 2);
+        gtk_container_set_border_width (GTK_CONTAINER (surface->priv->rows_box), ROW_PADDING + 1);
+        gtk_container_add (GTK_CONTAINER (surface), surface->priv->rows_box);
+        gtk_widget_show (surface->priv->rows_box);
+}
+
+NdStackSurface *
+nd_stack_surface_new (GdkScreen *screen)
+{
+        return g_object_new (ND_TYPE_STACK_SURFACE,
+                             "app-paintable", TRUE,
+                             "type", GTK_WINDOW_POPUP,
+                             "title", "Notifications",
+                             "resizable", FALSE,
+                             "type-hint", GDK_WINDOW_TYPE_HINT_NOTIFICATION,
+                             "screen", screen,
+                             NULL);
+}
+
+void
+nd_stack_surface_add (NdStackSurface *surface,
+                      NdNotification *notification,
+                      gboolean        at_bottom)
+{
+        SurfaceRow *row;
+        GObject    *binding;
+
+        g_return_if_fail (ND_IS_STACK_SURFACE (surface));
+
+        row = g_slice_new0 (SurfaceRow);
+        row->surface = surface;
+        row->notification = nd_notification_ref (notification);
+        row->box = GTK_WIDGET (nd_notification_box_new_for_notification (notification));
+
+        gtk_widget_add_events (row->box, GDK_ENTER_NOTIFY_MASK | GDK_LEAVE_NOTIFY_MASK);
+        g_signal_connect (row->box, "enter-notify-event",
+                          G_CALLBACK (on_row_enter_notify), row);
+        g_signal_connect (row->box, "leave-notify-event",
+                          G_CALLBACK (on_row_leave_notify), row);
+
+        binding = nd_notification_bind (notification);
+        g_signal_connect (binding, "changed",
+                          G_CALLBACK (on_row_notification_changed), row);
+        g_signal_connect (binding, "value-changed",
+                          G_CALLBACK (on_row_notification_changed), row);
+        g_signal_connect (binding, "closed",
+                          G_CALLBACK (on_row_notification_closed), row);
+        g_signal_connect (binding, "action-invoked",
+                          G_CALLBACK (on_row_action_invoked), row);
+
+        gtk_box_pack_start (GTK_BOX (surface->priv->rows_box), row->box, FALSE, FALSE, 0);
+
+        /* keep the newest row next to the stack origin */
+        if (at_bottom) {
+                surface->priv->rows = g_list_append (surface->priv->rows, row);
+        } else {
+                gtk_box_reorder_child (GTK_BOX (surface->priv->rows_box), row->box, 0);
+                surface->priv->rows = g_list_prepend (surface->priv->rows, row);
+        }
+
+        gtk_widget_show (row->box);
+        add_row_timeout (row);
+}
+
+void
+nd_stack_surface_remove_all (NdStackSurface *surface)
+{
+        g_return_if_fail (ND_IS_STACK_SURFACE (surface));
+
+        while (surface->priv->rows != NULL) {
+                remove_row (surface->priv->rows->data);
+        }
+}
+
+guint
+nd_stack_surface_get_n_notifications (NdStackSurface *surface)
+{
+        g_return_val_if_fail (ND_IS_STACK_SURFACE (surface), 0);
+
+        return g_list_length (surface->priv->rows);
+}
+
+/* The height of the surface with its current rows, from the same
+ * estimates the dock uses.
+ */
+int
+nd_stack_surface_estimate_height (NdStackSurface *surface)
+{
+        GList *l;
+        int    height;
+
+        g_return_val_if_fail (ND_IS_STACK_SURFACE (surface), 0);
+
+        if (surface->priv->rows == NULL)
+                return 0;
+
+        /* the border of the rows box, less the spacing counted for
+           the first row */
+        height = (ROW_PADDING + 1) * 2 - (ROW_SPACING + ROW_PADDING * 2);
+
+        for (l = surface->priv->rows; l != NULL; l = l->next) {
+                SurfaceRow *row = l->data;
+
+                height += nd_stack_surface_estimate_row_height (row->notification);
+        }
+
+        return height;
+}
+
+/* What a row for @notification adds to the height of the surface */
+int
+nd_stack_surface_estimate_row_height (NdNotification *notification)
+{
+        return nd_notification_box_estimate_height (notification)
+                + ROW_SPACING + ROW_PADDING * 2;
+}
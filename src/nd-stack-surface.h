@@ -0,0 +1,67 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef __ND_STACK_SURFACE_H
+#define __ND_STACK_SURFACE_H
+
+#include <gtk/gtk.h>
+
+#include "nd-notification.h"
+
+G_BEGIN_DECLS
+
+#define ND_TYPE_STACK_SURFACE         (nd_stack_surface_get_type ())
+#define ND_STACK_SURFACE(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), ND_TYPE_STACK_SURFACE, NdStackSurface))
+#define ND_STACK_SURFACE_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), ND_TYPE_STACK_SURFACE, NdStackSurfaceClass))
+#define ND_IS_STACK_SURFACE(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), ND_TYPE_STACK_SURFACE))
+#define ND_IS_STACK_SURFACE_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), ND_TYPE_STACK_SURFACE))
+#define ND_STACK_SURFACE_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), ND_TYPE_STACK_SURFACE, NdStackSurfaceClass))
+
+typedef struct NdStackSurfacePrivate NdStackSurfacePrivate;
+
+typedef struct
+{
+        GtkWindow              parent;
+        NdStackSurfacePrivate *priv;
+} NdStackSurface;
+
+typedef struct
+{
+        GtkWindowClass   parent_class;
+
+        void          (* notification_hidden) (NdStackSurface *surface,
+                                               NdNotification *notification);
+} NdStackSurfaceClass;
+
+GType               nd_stack_surface_get_type               (void);
+
+NdStackSurface *    nd_stack_surface_new                    (GdkScreen      *screen);
+
+void                nd_stack_surface_add                    (NdStackSurface *surface,
+                                                             NdNotification *notification,
+                                                             gboolean        at_bottom);
+void                nd_stack_surface_remove_all             (NdStackSurface *surface);
+guint               nd_stack_surface_get_n_notifications    (NdStackSurface *surface);
+int                 nd_stack_surface_estimate_height        (NdStackSurface *surface);
+int                 nd_stack_surface_estimate_row_height    (NdNotification *notification);
+
+G_END_DECLS
+
+#endif /* __ND_STACK_SURFACE_H */
@@ -31,22 +31,65 @@
 #include <gdk/gdkx.h>
 
 #include "nd-stack.h"
+#include "nd-stack-surface.h"
 
 #define ND_STACK_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ND_TYPE_STACK, NdStackPrivate))
 
 #define NOTIFY_STACK_SPACING 2
 #define WORKAREA_PADDING 6
 
+/* in microseconds, to compare with frame times */
+#define ANIMATION_DURATION (200 * 1000)
+
+typedef struct
+{
+        NdBubble       *bubble;
+        gint            from_x;
+        gint            from_y;
+        gint            to_x;
+        gint            to_y;
+        gint            x;
+        gint            y;
+        gdouble         from_opacity;
+        gint64          start_time;
+} BubbleAnimation;
+
 struct NdStackPrivate
 {
         GdkScreen      *screen;
         guint           monitor;
         NdStackLocation location;
         GList          *bubbles;
+
+        /* Work area on the monitor less the padding, until the work
+           area or the current desktop changes */
+        GdkRectangle    area;
+        gboolean        area_valid;
         guint           update_id;
+
+        gboolean        animate;
+        GList          *animations;
+        GtkWidget      *tick_widget;
+        guint           tick_id;
+
+        gboolean        single_surface;
+        NdStackSurface *surface;
+
+        /* Whether the active window fills the monitor */
+        gboolean        fullscreen;
 };
 
+enum {
+        NOTIFICATION_HIDDEN,
+        LAST_SIGNAL
+};
+
+static guint signals [LAST_SIGNAL] = { 0, };
+
 static void     nd_stack_finalize    (GObject       *object);
+static void     clear_animation_tick   (NdStack       *stack);
+static void     on_tick_widget_destroy (GtkWidget     *widget,
+                                        NdStack       *stack);
 
 G_DEFINE_TYPE (NdStack, nd_stack, G_TYPE_OBJECT)
 
@@ -240,6 +283,15 @@ nd_stack_class_init (NdStackClass *klass)
 
         object_class->finalize = nd_stack_finalize;
 
+        signals[NOTIFICATION_HIDDEN] =
+                g_signal_new ("notification-hidden",
+                              G_TYPE_FROM_CLASS (klass),
+                              G_SIGNAL_RUN_LAST,
+                              0,
+                              NULL, NULL,
+                              g_cclosure_marshal_VOID__BOXED,
+                              G_TYPE_NONE, 1, ND_TYPE_NOTIFICATION);
+
         g_type_class_add_private (klass, sizeof (NdStackPrivate));
 }
 
@@ -266,11 +318,45 @@ nd_stack_finalize (GObject *object)
                 g_source_remove (stack->priv->update_id);
         }
 
+        clear_animation_tick (stack);
+
+        g_list_free_full (stack->priv->animations, g_free);
         g_list_free (stack->priv->bubbles);
 
+        if (stack->priv->surface != NULL) {
+                g_signal_handlers_disconnect_by_data (stack->priv->surface, stack);
+                gtk_widget_destroy (GTK_WIDGET (stack->priv->surface));
+        }
+
         G_OBJECT_CLASS (nd_stack_parent_class)->finalize (object);
 }
 
+void
+nd_stack_set_animate (NdStack  *stack,
+                      gboolean  animate)
+{
+        g_return_if_fail (ND_IS_STACK (stack));
+
+        stack->priv->animate = animate;
+}
+
+void
+nd_stack_set_fullscreen (NdStack  *stack,
+                         gboolean  fullscreen)
+{
+        g_return_if_fail (ND_IS_STACK (stack));
+
+        stack->priv->fullscreen = fullscreen;
+}
+
+gboolean
+nd_stack_get_fullscreen (NdStack *stack)
+{
+        g_return_val_if_fail (ND_IS_STACK (stack), FALSE);
+
+        return stack->priv->fullscreen;
+}
+
 void
 nd_stack_set_location (NdStack        *stack,
                        NdStackLocation location)
@@ -311,6 +397,220 @@ add_padding_to_rect (GdkRectangle *rect)
                 rect->height = 0;
 }
 
+static void
+get_stack_area (NdStack      *stack,
+                GdkRectangle *area)
+{
+        if (!stack->priv->area_valid) {
+                GdkRectangle monitor;
+
+                get_work_area (stack, &stack->priv->area);
+                gdk_screen_get_monitor_geometry (stack->priv->screen,
+                                                 stack->priv->monitor,
+                                                 &monitor);
+                gdk_rectangle_intersect (&monitor, &stack->priv->area, &stack->priv->area);
+
+                add_padding_to_rect (&stack->priv->area);
+                stack->priv->area_valid = TRUE;
+        }
+
+        *area = stack->priv->area;
+}
+
+static void
+clear_animation_tick (NdStack *stack)
+{
+        if (stack->priv->tick_widget == NULL)
+                return;
+
+        if (stack->priv->tick_id != 0) {
+                gtk_widget_remove_tick_callback (stack->priv->tick_widget,
+                                                 stack->priv->tick_id);
+                stack->priv->tick_id = 0;
+        }
+
+        g_signal_handlers_disconnect_by_func (stack->priv->tick_widget,
+                                              G_CALLBACK (on_tick_widget_destroy),
+                                              stack);
+        g_clear_object (&stack->priv->tick_widget);
+}
+
+static BubbleAnimation *
+find_animation (NdStack  *stack,
+                NdBubble *bubble)
+{
+        GList *l;
+
+        for (l = stack->priv->animations; l != NULL; l = l->next) {
+                BubbleAnimation *animation = l->data;
+
+                if (animation->bubble == bubble)
+                        return animation;
+        }
+
+        return NULL;
+}
+
+/* Moves every animating bubble to where it should be at the time of
+ * this frame.  Positions depend on the frame time only, so frames the
+ * compositor did not keep up with are simply skipped.
+ */
+static gboolean
+on_animation_tick (GtkWidget     *widget,
+                   GdkFrameClock *frame_clock,
+                   gpointer       user_data)
+{
+        NdStack *stack;
+        gint64   now;
+        GList   *l;
+
+        stack = ND_STACK (user_data);
+        now = gdk_frame_clock_get_frame_time (frame_clock);
+
+        l = stack->priv->animations;
+        while (l != NULL) {
+                BubbleAnimation *animation = l->data;
+                GList           *next = l->next;
+                gdouble          t;
+
+                if (animation->start_time == 0)
+                        animation->start_time = now;
+
+                t = (gdouble) (now - animation->start_time) / ANIMATION_DURATION;
+                t = CLAMP (t, 0.0, 1.0);
+
+                /* ease out cubic */
+                t = 1.0 - (1.0 - t) * (1.0 - t) * (1.0 - t);
+
+                animation->x = animation->from_x + (animation->to_x - animation->from_x) * t;
+                animation->y = animation->from_y + (animation->to_y - animation->from_y) * t;
+
+                gtk_window_move (GTK_WINDOW (animation->bubble), animation->x, animation->y);
+                gtk_widget_set_opacity (GTK_WIDGET (animation->bubble),
+                                        animation->from_opacity + (1.0 - animation->from_opacity) * t);
+
+                if (t >= 1.0) {
+                        stack->priv->animations = g_list_delete_link (stack->priv->animations, l);
+                        g_free (animation);
+                }
+
+                l = next;
+        }
+
+        if (stack->priv->animations == NULL) {
+                /* removed by returning G_SOURCE_REMOVE */
+                stack->priv->tick_id = 0;
+                clear_animation_tick (stack);
+                return G_SOURCE_REMOVE;
+        }
+
+        return G_SOURCE_CONTINUE;
+}
+
+static void
+ensure_animation_tick (NdStack *stack)
+{
+        BubbleAnimation *animation;
+
+        if (stack->priv->tick_id != 0 || stack->priv->animations == NULL)
+                return;
+
+        /* all the moves of a frame are done from a single tick, on a
+           bubble held until the tick is removed */
+        animation = stack->priv->animations->data;
+        stack->priv->tick_widget = g_object_ref (GTK_WIDGET (animation->bubble));
+        stack->priv->tick_id = gtk_widget_add_tick_callback (stack->priv->tick_widget,
+                                                             on_animation_tick,
+                                                             stack,
+                                                             NULL);
+        g_signal_connect (stack->priv->tick_widget, "destroy",
+                          G_CALLBACK (on_tick_widget_destroy), stack);
+}
+
+static void
+remove_animation (NdStack  *stack,
+                  NdBubble *bubble)
+{
+        BubbleAnimation *animation;
+
+        animation = find_animation (stack, bubble);
+        if (animation != NULL) {
+                stack->priv->animations = g_list_remove (stack->priv->animations, animation);
+                g_free (animation);
+        }
+
+        if (stack->priv->tick_widget == GTK_WIDGET (bubble)) {
+                clear_animation_tick (stack);
+                ensure_animation_tick (stack);
+        }
+}
+
+/* The tick moves on to another animating bubble when its bubble goes
+   away, whether or not the stack is told about it */
+static void
+on_tick_widget_destroy (GtkWidget *widget,
+                        NdStack   *stack)
+{
+        remove_animation (stack, ND_BUBBLE (widget));
+}
+
+static void
+animate_bubble (NdStack  *stack,
+                NdBubble *bubble,
+                gint      x,
+                gint      y,
+                gboolean  fade_in)
+{
+        BubbleAnimation *animation;
+
+        animation = find_animation (stack, bubble);
+
+        if (animation == NULL) {
+                animation = g_new0 (BubbleAnimation, 1);
+                animation->bubble = bubble;
+                animation->from_opacity = 1.0;
+
+                if (fade_in) {
+                        animation->x = x;
+                        animation->y = y;
+                } else {
+                        gtk_window_get_position (GTK_WINDOW (bubble),
+                                                 &animation->x,
+                                                 &animation->y);
+                }
+
+                stack->priv->animations = g_list_prepend (stack->priv->animations, animation);
+        } else if (animation->to_x == x && animation->to_y == y && !fade_in) {
+                return;
+        }
+
+        animation->from_x = animation->x;
+        animation->from_y = animation->y;
+        animation->to_x = x;
+        animation->to_y = y;
+        animation->start_time = 0;
+
+        if (fade_in) {
+                animation->from_opacity = 0.0;
+                gtk_widget_set_opacity (GTK_WIDGET (bubble), 0.0);
+        }
+
+        ensure_animation_tick (stack);
+}
+
+static void
+move_bubble (NdStack  *stack,
+             NdBubble *bubble,
+             gint      x,
+             gint      y)
+{
+        if (stack->priv->animate && gtk_widget_get_mapped (GTK_WIDGET (bubble))) {
+                animate_bubble (stack, bubble, x, y, FALSE);
+        } else {
+                gtk_window_move (GTK_WINDOW (bubble), x, y);
+        }
+}
+
 static void
 nd_stack_shift_notifications (NdStack     *stack,
                               NdBubble    *bubble,
@@ -321,7 +621,6 @@ nd_stack_shift_notifications (NdStack     *stack,
                               gint        *nw_y)
 {
         GdkRectangle    workarea;
-        GdkRectangle    monitor;
         GdkRectangle   *positions;
         GList          *l;
         gint            x, y;
@@ -330,13 +629,7 @@ nd_stack_shift_notifications (NdStack     *stack,
         int             i;
         int             n_wins;
 
-        get_work_area (stack, &workarea);
-        gdk_screen_get_monitor_geometry (stack->priv->screen,
-                                         stack->priv->monitor,
-                                         &monitor);
-        gdk_rectangle_intersect (&monitor, &workarea, &workarea);
-
-        add_padding_to_rect (&workarea);
+        get_stack_area (stack, &workarea);
 
         n_wins = g_list_length (stack->priv->bubbles);
         positions = g_new0 (GdkRectangle, n_wins);
@@ -357,10 +650,10 @@ nd_stack_shift_notifications (NdStack     *stack,
 
         for (i = 0, l = stack->priv->bubbles; l != NULL; i++, l = l->next) {
                 NdBubble       *nw2 = ND_BUBBLE (l->data);
-                GtkRequisition  req;
+                int             width, height;
 
                 if (bubble == NULL || nw2 != bubble) {
-                        gtk_widget_get_preferred_size (GTK_WIDGET (nw2), NULL, &req);
+                        nd_bubble_get_size (nw2, &width, &height);
 
                         translate_coordinates (stack->priv->location,
                                                &workarea,
@@ -368,8 +661,8 @@ nd_stack_shift_notifications (NdStack     *stack,
                                                &y,
                                                &shiftx,
                                                &shifty,
-                                               req.width,
-                                               req.height + NOTIFY_STACK_SPACING);
+                                               width,
+                                               height + NOTIFY_STACK_SPACING);
                         positions[i].x = x;
                         positions[i].y = y;
                 } else if (nw_l != NULL) {
@@ -385,16 +678,47 @@ nd_stack_shift_notifications (NdStack     *stack,
                 NdBubble *nw2 = ND_BUBBLE (l->data);
 
                 if (bubble == NULL || nw2 != bubble) {
-                        gtk_window_move (GTK_WINDOW (nw2), positions[i].x, positions[i].y);
+                        move_bubble (stack, nw2, positions[i].x, positions[i].y);
                 }
         }
 
         g_free (positions);
 }
 
+static void
+update_surface_position (NdStack *stack)
+{
+        GdkRectangle workarea;
+        int          width, height;
+        int          x, y;
+        int          shiftx = 0;
+        int          shifty = 0;
+
+        get_stack_area (stack, &workarea);
+
+        gtk_widget_get_preferred_width (GTK_WIDGET (stack->priv->surface), NULL, &width);
+        gtk_widget_get_preferred_height_for_width (GTK_WIDGET (stack->priv->surface),
+                                                   width, NULL, &height);
+
+        get_origin_coordinates (stack->priv->location,
+                                &workarea,
+                                &x, &y,
+                                &shiftx,
+                                &shifty,
+                                width,
+                                height);
+
+        gtk_window_move (GTK_WINDOW (stack->priv->surface), x, y);
+}
+
 static void
 update_position (NdStack *stack)
 {
+        if (stack->priv->surface != NULL
+            && gtk_widget_get_visible (GTK_WIDGET (stack->priv->surface))) {
+                update_surface_position (stack);
+        }
+
         nd_stack_shift_notifications (stack,
                                       NULL, /* window */
                                       NULL, /* list pointer */
@@ -404,6 +728,18 @@ update_position (NdStack *stack)
                                       NULL); /* out window y */
 }
 
+/* Called when the work area, the current desktop or the monitor
+ * geometry changed.
+ */
+void
+nd_stack_invalidate_work_area (NdStack *stack)
+{
+        g_return_if_fail (ND_IS_STACK (stack));
+
+        stack->priv->area_valid = FALSE;
+        nd_stack_queue_update_position (stack);
+}
+
 static gboolean
 update_position_idle (NdStack *stack)
 {
@@ -423,24 +759,162 @@ nd_stack_queue_update_position (NdStack *stack)
         stack->priv->update_id = g_idle_add ((GSourceFunc) update_position_idle, stack);
 }
 
+static void
+on_surface_notification_hidden (NdStackSurface *surface,
+                                NdNotification *notification,
+                                NdStack        *stack)
+{
+        nd_stack_queue_update_position (stack);
+
+        g_signal_emit (stack, signals[NOTIFICATION_HIDDEN], 0, notification);
+}
+
+static void
+on_surface_size_allocate (GtkWidget     *widget,
+                          GtkAllocation *allocation,
+                          NdStack       *stack)
+{
+        /* the stack grows away from its origin */
+        nd_stack_queue_update_position (stack);
+}
+
+void
+nd_stack_set_single_surface (NdStack  *stack,
+                             gboolean  single_surface)
+{
+        g_return_if_fail (ND_IS_STACK (stack));
+
+        stack->priv->single_surface = single_surface;
+}
+
+gboolean
+nd_stack_get_single_surface (NdStack *stack)
+{
+        g_return_val_if_fail (ND_IS_STACK (stack), FALSE);
+
+        return stack->priv->single_surface;
+}
+
+/* Shows @notification in the single surface of the stack. */
+void
+nd_stack_add_notification (NdStack        *stack,
+                           NdNotification *notification)
+{
+        gboolean at_bottom;
+
+        g_return_if_fail (ND_IS_STACK (stack));
+
+        if (stack->priv->surface == NULL) {
+                stack->priv->surface = nd_stack_surface_new (stack->priv->screen);
+                g_signal_connect (stack->priv->surface, "notification-hidden",
+                                  G_CALLBACK (on_surface_notification_hidden), stack);
+                g_signal_connect_after (stack->priv->surface, "size-allocate",
+                                        G_CALLBACK (on_surface_size_allocate), stack);
+        }
+
+        at_bottom = stack->priv->location == ND_STACK_LOCATION_BOTTOM_LEFT
+                || stack->priv->location == ND_STACK_LOCATION_BOTTOM_RIGHT;
+
+        nd_stack_surface_add (stack->priv->surface, notification, at_bottom);
+
+        update_surface_position (stack);
+        gtk_widget_show (GTK_WIDGET (stack->priv->surface));
+}
+
+/* Number of notifications shown by the stack, as bubbles or in its
+ * single surface.
+ */
+guint
+nd_stack_get_n_shown (NdStack *stack)
+{
+        guint n_shown;
+
+        g_return_val_if_fail (ND_IS_STACK (stack), 0);
+
+        n_shown = g_list_length (stack->priv->bubbles);
+
+        if (stack->priv->surface != NULL) {
+                n_shown += nd_stack_surface_get_n_notifications (stack->priv->surface);
+        }
+
+        return n_shown;
+}
+
+/* Whether a bubble of @height still fits in the work area next to the
+ * bubbles already shown, from their cached sizes.  An empty stack
+ * takes any bubble, so that a tall one is not held back forever.
+ */
+gboolean
+nd_stack_has_room (NdStack *stack,
+                   int      height)
+{
+        GdkRectangle area;
+        GList       *l;
+        int          used;
+
+        g_return_val_if_fail (ND_IS_STACK (stack), FALSE);
+
+        if (nd_stack_get_n_shown (stack) == 0)
+                return TRUE;
+
+        get_stack_area (stack, &area);
+
+        used = 0;
+        for (l = stack->priv->bubbles; l != NULL; l = l->next) {
+                int bubble_height;
+
+                nd_bubble_get_size (ND_BUBBLE (l->data), NULL, &bubble_height);
+                used += bubble_height + NOTIFY_STACK_SPACING;
+        }
+
+        if (stack->priv->surface != NULL
+            && nd_stack_surface_get_n_notifications (stack->priv->surface) > 0) {
+                used += nd_stack_surface_estimate_height (stack->priv->surface)
+                        + NOTIFY_STACK_SPACING;
+        }
+
+        return used + height + NOTIFY_STACK_SPACING <= area.height;
+}
+
+/* The height @notification would take up in @stack, as a bubble or as
+ * a row of the single surface.
+ */
+int
+nd_stack_estimate_height (NdStack        *stack,
+                          NdNotification *notification)
+{
+        g_return_val_if_fail (ND_IS_STACK (stack), 0);
+
+        if (stack->priv->single_surface)
+                return nd_stack_surface_estimate_row_height (notification);
+
+        return nd_bubble_estimate_height (notification);
+}
+
 void
 nd_stack_add_bubble (NdStack  *stack,
                      NdBubble *bubble,
                      gboolean  new_notification)
 {
-        GtkRequisition  req;
+        int             width, height;
         int             x, y;
 
-        gtk_widget_get_preferred_size (GTK_WIDGET (bubble), NULL, &req);
+        nd_bubble_get_size (bubble, &width, &height);
         nd_stack_shift_notifications (stack,
                                       bubble,
                                       NULL,
-                                      req.width,
-                                      req.height + NOTIFY_STACK_SPACING,
+                                      width,
+                                      height + NOTIFY_STACK_SPACING,
                                       &x,
                                       &y);
-        gtk_widget_show (GTK_WIDGET (bubble));
-        gtk_window_move (GTK_WINDOW (bubble), x, y);
+        if (stack->priv->animate && new_notification) {
+                gtk_window_move (GTK_WINDOW (bubble), x, y);
+                gtk_widget_show (GTK_WIDGET (bubble));
+                animate_bubble (stack, bubble, x, y, TRUE);
+        } else {
+                gtk_widget_show (GTK_WIDGET (bubble));
+                move_bubble (stack, bubble, x, y);
+        }
 
         if (new_notification) {
                 g_signal_connect_swapped (G_OBJECT (bubble),
@@ -457,6 +931,8 @@ nd_stack_remove_bubble (NdStack  *stack,
 {
         GList *remove_l = NULL;
 
+        remove_animation (stack, bubble);
+
         nd_stack_shift_notifications (stack,
                                       bubble,
                                       &remove_l,
@@ -480,4 +956,8 @@ nd_stack_remove_all (NdStack  *stack)
         bubbles = g_list_copy (stack->priv->bubbles);
         g_list_foreach (bubbles, (GFunc)gtk_widget_destroy, NULL);
         g_list_free (bubbles);
+
+        if (stack->priv->surface != NULL) {
+                nd_stack_surface_remove_all (stack->priv->surface);
+        }
 }
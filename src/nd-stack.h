@@ -64,6 +64,21 @@ NdStack *       nd_stack_new                   (GdkScreen      *screen,
 
 void            nd_stack_set_location          (NdStack        *stack,
                                                 NdStackLocation location);
+void            nd_stack_set_animate           (NdStack        *stack,
+                                                gboolean        animate);
+void            nd_stack_set_single_surface    (NdStack        *stack,
+                                                gboolean        single_surface);
+gboolean        nd_stack_get_single_surface    (NdStack        *stack);
+void            nd_stack_set_fullscreen        (NdStack        *stack,
+                                                gboolean        fullscreen);
+gboolean        nd_stack_get_fullscreen        (NdStack        *stack);
+void            nd_stack_add_notification      (NdStack        *stack,
+                                                NdNotification *notification);
+guint           nd_stack_get_n_shown           (NdStack        *stack);
+gboolean        nd_stack_has_room              (NdStack        *stack,
+                                                int             height);
+int             nd_stack_estimate_height       (NdStack        *stack,
+                                                NdNotification *notification);
 void            nd_stack_add_bubble            (NdStack        *stack,
                                                 NdBubble       *bubble,
                                                 gboolean        new_notification);
@@ -72,6 +87,7 @@ void            nd_stack_remove_bubble         (NdStack        *stack,
 void            nd_stack_remove_all            (NdStack        *stack);
 GList *         nd_stack_get_bubbles           (NdStack        *stack);
 void            nd_stack_queue_update_position (NdStack        *stack);
+void            nd_stack_invalidate_work_area  (NdStack        *stack);
 
 G_END_DECLS
 
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "nd-string-pool.h"
+
+/*
+ * Strings that come back with most notifications, such as senders,
+ * application names, icons, action keys and hint keys, are kept once
+ * with a reference count.  Interned strings are equal if and only if
+ * they are the same pointer.
+ *
+ * The pool is shared by the dispatcher thread, which parses hints, and
+ * the main thread, so it is locked.
+ */
+
+typedef struct
+{
+  guint ref_count;
+  gchar str[1];
+} Entry;
+
+G_LOCK_DEFINE_STATIC (pool);
+
+/* Entry::str -> Entry */
+static GHashTable *pool = NULL;
+static guint n_references = 0;
+
+/* Returns @str from the pool, adding it if needed.  The reference is
+ * given back with nd_string_pool_release().
+ */
+const gchar *
+nd_string_pool_intern (const gchar *str)
+{
+  Entry *entry;
+
+  if (str == NULL)
+    return NULL;
+
+  G_LOCK (pool);
+
+  if (pool == NULL)
+    pool = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+
+  entry = g_hash_table_lookup (pool, str);
+
+  if (entry == NULL)
+    {
+      gsize length;
+
+      length = strlen (str);
+      entry = g_malloc (G_STRUCT_OFFSET (Entry, str) + length + 1);
+      entry->ref_count = 0;
+      memcpy (entry->str, str, length + 1);
+
+      g_hash_table_insert (pool, entry->str, entry);
+    }
+
+  entry->ref_count++;
+  n_references++;
+
+  G_UNLOCK (pool);
+
+  return entry->str;
+}
+
+/* @str must have been returned by nd_string_pool_intern(), or be NULL. */
+void
+nd_string_pool_release (const gchar *str)
+{
+  Entry *entry;
+
+  if (str == NULL)
+    return;
+
+  entry = (Entry *) (str - G_STRUCT_OFFSET (Entry, str));
+
+  G_LOCK (pool);
+
+  n_references--;
+
+  if (--entry->ref_count == 0)
+    g_hash_table_remove (pool, entry->str);
+
+  G_UNLOCK (pool);
+}
+
+/* The number of distinct strings in the pool, and of references to
+ * them.
+ */
+void
+nd_string_pool_get_stats (guint *n_unique,
+                          guint *n_total)
+{
+  G_LOCK (pool);
+
+  if (n_unique != NULL)
+    *n_unique = pool != NULL ? g_hash_table_size (pool) : 0;
+
+  if (n_total != NULL)
+    *n_total = n_references;
+
+  G_UNLOCK (pool);
+}
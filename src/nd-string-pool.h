@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ND_STRING_POOL_H
+#define ND_STRING_POOL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+const gchar *nd_string_pool_intern    (const gchar *str);
+void         nd_string_pool_release   (const gchar *str);
+
+void         nd_string_pool_get_stats (guint       *n_unique,
+                                       guint       *n_total);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,492 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#ifdef HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
+#include "nd-watchdog.h"
+
+/*
+ * The main loop is timed from the poll function of the default main
+ * context: from the moment poll() returns until it is called again,
+ * the sources that became ready are being dispatched.  A thread
+ * compares that time with the threshold and, once a dispatch takes
+ * longer, appends the recent trace and a backtrace of the main thread
+ * to stalls.log in the user cache directory.
+ *
+ * Only the main thread can unwind its own stack, so it is asked to
+ * write the backtrace from a signal handler.
+ *
+ * Trace points are static labels at the start of the callbacks that
+ * run on the main loop.  The last one the main thread passed since it
+ * polled names the source that stalled.
+ */
+
+#define N_TRACE_ENTRIES 256
+#define MAX_FRAMES 64
+#define BACKTRACE_SIGNAL SIGUSR2
+
+/* How long to wait for the main thread to write its backtrace */
+#define BACKTRACE_TIMEOUT_MS 1000
+
+typedef struct
+{
+  gint64       time;
+  const gchar *label;
+} TraceEntry;
+
+struct _NdWatchdog
+{
+  GObject    parent;
+
+  guint      threshold_ms;
+  GPollFunc  poll_func;
+
+  GThread   *thread;
+  GMutex     mutex;
+  GCond      cond;
+  gboolean   quit;
+
+  gint       log_fd;
+
+  /* Written by the watchdog thread */
+  guint      n_stalls;
+  guint      longest_stall;
+};
+
+G_DEFINE_TYPE (NdWatchdog, nd_watchdog, G_TYPE_OBJECT)
+
+/* Only one watchdog can own the poll function of the main context */
+static NdWatchdog *watchdog_singleton = NULL;
+static pthread_t main_thread;
+static gint tracing = FALSE;
+
+/* Monotonic time at which the current dispatch started, and a serial
+ * to tell dispatches apart, read together under the lock.
+ */
+static GMutex dispatch_lock;
+static gboolean dispatching = FALSE;
+static gint64 dispatch_start = 0;
+static guint dispatch_serial = 0;
+
+static TraceEntry trace[N_TRACE_ENTRIES];
+static guint trace_next = 0;
+static gpointer current_label = NULL;
+
+static volatile sig_atomic_t backtrace_fd = -1;
+static gint backtrace_done = FALSE;
+
+/* Records that the calling thread reached @label, which must be a
+ * static string.  Does nothing without a watchdog.
+ */
+void
+nd_watchdog_trace (const gchar *label)
+{
+  guint slot;
+
+  if (!g_atomic_int_get (&tracing))
+    return;
+
+  slot = (guint) g_atomic_int_add ((gint *) &trace_next, 1) % N_TRACE_ENTRIES;
+  trace[slot].time = g_get_monotonic_time ();
+  trace[slot].label = label;
+
+  if (pthread_equal (pthread_self (), main_thread))
+    g_atomic_pointer_set (&current_label, (gpointer) label);
+}
+
+static gint
+watchdog_poll (GPollFD *fds,
+               guint    n_fds,
+               gint     timeout)
+{
+  gint result;
+  gint64 now;
+
+  g_mutex_lock (&dispatch_lock);
+  dispatching = FALSE;
+  g_mutex_unlock (&dispatch_lock);
+
+  g_atomic_pointer_set (&current_label, NULL);
+
+  result = watchdog_singleton->poll_func (fds, n_fds, timeout);
+  now = g_get_monotonic_time ();
+
+  g_mutex_lock (&dispatch_lock);
+  dispatch_start = now;
+  dispatch_serial++;
+  dispatching = TRUE;
+  g_mutex_unlock (&dispatch_lock);
+
+  return result;
+}
+
+static void
+backtrace_handler (int signum)
+{
+  int saved_errno;
+
+  saved_errno = errno;
+
+#ifdef HAVE_EXECINFO_H
+  if (backtrace_fd >= 0)
+    {
+      void *frames[MAX_FRAMES];
+      int n_frames;
+
+      n_frames = backtrace (frames, MAX_FRAMES);
+      backtrace_symbols_fd (frames, n_frames, backtrace_fd);
+    }
+#endif
+
+  g_atomic_int_set (&backtrace_done, TRUE);
+
+  errno = saved_errno;
+}
+
+static void
+write_all (gint         fd,
+           const gchar *data,
+           gsize        length)
+{
+  while (length > 0)
+    {
+      gssize written;
+
+      written = write (fd, data, length);
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return;
+        }
+
+      data += written;
+      length -= written;
+    }
+}
+
+static void
+write_report (NdWatchdog *watchdog,
+              guint       elapsed)
+{
+  const gchar *label;
+  GDateTime *now;
+  gchar *timestamp;
+  GString *report;
+  gint64 time;
+  guint next;
+  guint i;
+
+  label = g_atomic_pointer_get (&current_label);
+  if (label == NULL)
+    label = "an untraced source";
+
+  g_warning ("Main loop stalled for %u ms in %s", elapsed, label);
+
+  if (watchdog->log_fd < 0)
+    return;
+
+  now = g_date_time_new_now_local ();
+  timestamp = g_date_time_format (now, "%F %T");
+  g_date_time_unref (now);
+
+  report = g_string_new (NULL);
+  g_string_append_printf (report, "%s: main loop stalled for %u ms in %s\n",
+                          timestamp, elapsed, label);
+  g_string_append (report, "Recent trace, in ms before now:\n");
+
+  time = g_get_monotonic_time ();
+  next = (guint) g_atomic_int_get ((gint *) &trace_next);
+
+  for (i = 0; i < N_TRACE_ENTRIES; i++)
+    {
+      TraceEntry *entry;
+
+      entry = &trace[(next + i) % N_TRACE_ENTRIES];
+      if (entry->label == NULL)
+        continue;
+
+      g_string_append_printf (report, "  %10.1f  %s\n",
+                              (time - entry->time) / 1000.0, entry->label);
+    }
+
+  g_string_append (report, "Main thread backtrace:\n");
+  write_all (watchdog->log_fd, report->str, report->len);
+
+  g_string_free (report, TRUE);
+  g_free (timestamp);
+
+  g_atomic_int_set (&backtrace_done, FALSE);
+
+  if (pthread_kill (main_thread, BACKTRACE_SIGNAL) == 0)
+    {
+      for (i = 0; i < BACKTRACE_TIMEOUT_MS / 10; i++)
+        {
+          if (g_atomic_int_get (&backtrace_done))
+            break;
+
+          g_usleep (10 * 1000);
+        }
+    }
+
+  if (!g_atomic_int_get (&backtrace_done))
+    {
+      const gchar *message = "  (not available)\n";
+
+      write_all (watchdog->log_fd, message, strlen (message));
+    }
+
+  write_all (watchdog->log_fd, "\n", 1);
+}
+
+/* Reports a dispatch once, when it crosses the threshold, and keeps
+ * measuring it until it is over.
+ */
+static void
+check_stall (NdWatchdog *watchdog,
+             guint      *reported_serial)
+{
+  gboolean busy;
+  guint serial;
+  gint64 start;
+  gint64 elapsed_ms;
+  guint elapsed;
+
+  g_mutex_lock (&dispatch_lock);
+  busy = dispatching;
+  serial = dispatch_serial;
+  start = dispatch_start;
+  g_mutex_unlock (&dispatch_lock);
+
+  if (!busy)
+    return;
+
+  elapsed_ms = (g_get_monotonic_time () - start) / G_TIME_SPAN_MILLISECOND;
+  if (elapsed_ms < watchdog->threshold_ms)
+    return;
+
+  elapsed = (guint) MIN (elapsed_ms, G_MAXUINT);
+
+  if (elapsed > (guint) g_atomic_int_get ((gint *) &watchdog->longest_stall))
+    g_atomic_int_set ((gint *) &watchdog->longest_stall, elapsed);
+
+  if (serial == *reported_serial)
+    return;
+
+  *reported_serial = serial;
+  g_atomic_int_inc ((gint *) &watchdog->n_stalls);
+
+  write_report (watchdog, elapsed);
+}
+
+static gpointer
+watchdog_thread_func (gpointer user_data)
+{
+  NdWatchdog *watchdog;
+  gint64 interval;
+  guint reported_serial;
+
+  watchdog = ND_WATCHDOG (user_data);
+  interval = MAX (watchdog->threshold_ms / 4, 50) * G_TIME_SPAN_MILLISECOND;
+
+  g_mutex_lock (&dispatch_lock);
+  reported_serial = dispatch_serial - 1;
+  g_mutex_unlock (&dispatch_lock);
+
+  g_mutex_lock (&watchdog->mutex);
+
+  while (!watchdog->quit)
+    {
+      gint64 end_time;
+
+      end_time = g_get_monotonic_time () + interval;
+      if (g_cond_wait_until (&watchdog->cond, &watchdog->mutex, end_time))
+        continue;
+
+      g_mutex_unlock (&watchdog->mutex);
+      check_stall (watchdog, &reported_serial);
+      g_mutex_lock (&watchdog->mutex);
+    }
+
+  g_mutex_unlock (&watchdog->mutex);
+
+  return NULL;
+}
+
+static gint
+open_log (void)
+{
+  gchar *dir;
+  gchar *path;
+  gint fd;
+
+  dir = g_build_filename (g_get_user_cache_dir (), "notification-daemon", NULL);
+  path = g_build_filename (dir, "stalls.log", NULL);
+
+  fd = -1;
+  if (g_mkdir_with_parents (dir, 0700) == 0)
+    fd = g_open (path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+
+  if (fd < 0)
+    g_warning ("Failed to open %s: %s", path, g_strerror (errno));
+
+  g_free (path);
+  g_free (dir);
+
+  return fd;
+}
+
+static void
+set_backtrace_handler (void (* handler) (int))
+{
+  struct sigaction action;
+
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = handler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset (&action.sa_mask);
+
+  sigaction (BACKTRACE_SIGNAL, &action, NULL);
+}
+
+static void
+nd_watchdog_finalize (GObject *object)
+{
+  NdWatchdog *watchdog;
+
+  watchdog = ND_WATCHDOG (object);
+
+  g_mutex_lock (&watchdog->mutex);
+  watchdog->quit = TRUE;
+  g_cond_signal (&watchdog->cond);
+  g_mutex_unlock (&watchdog->mutex);
+
+  g_thread_join (watchdog->thread);
+
+  g_main_context_set_poll_func (g_main_context_default (), watchdog->poll_func);
+  g_atomic_int_set (&tracing, FALSE);
+  watchdog_singleton = NULL;
+
+  g_mutex_lock (&dispatch_lock);
+  dispatching = FALSE;
+  g_mutex_unlock (&dispatch_lock);
+
+  set_backtrace_handler (SIG_DFL);
+  backtrace_fd = -1;
+
+  if (watchdog->log_fd >= 0)
+    close (watchdog->log_fd);
+
+  g_cond_clear (&watchdog->cond);
+  g_mutex_clear (&watchdog->mutex);
+
+  G_OBJECT_CLASS (nd_watchdog_parent_class)->finalize (object);
+}
+
+static void
+nd_watchdog_class_init (NdWatchdogClass *watchdog_class)
+{
+  GObjectClass *object_class;
+
+  object_class = G_OBJECT_CLASS (watchdog_class);
+
+  object_class->finalize = nd_watchdog_finalize;
+}
+
+static void
+nd_watchdog_init (NdWatchdog *watchdog)
+{
+  g_mutex_init (&watchdog->mutex);
+  g_cond_init (&watchdog->cond);
+}
+
+/* Watches the default main context, which must be run by the calling
+ * thread, for dispatches longer than @threshold_ms.
+ */
+NdWatchdog *
+nd_watchdog_new (guint threshold_ms)
+{
+  NdWatchdog *watchdog;
+  GMainContext *context;
+
+  g_return_val_if_fail (watchdog_singleton == NULL, NULL);
+  g_return_val_if_fail (threshold_ms > 0, NULL);
+
+  watchdog = g_object_new (ND_TYPE_WATCHDOG, NULL);
+  watchdog->threshold_ms = threshold_ms;
+  watchdog->log_fd = open_log ();
+
+#ifdef HAVE_EXECINFO_H
+  /* The first call to backtrace() loads libgcc and allocates, neither
+   * of which is safe in a signal handler.  Once it has run here, later
+   * calls only walk the stack, and backtrace_symbols_fd() writes to the
+   * descriptor without allocating, so backtrace_handler can use both.
+   */
+  {
+    void *frame;
+
+    backtrace (&frame, 1);
+  }
+#endif
+
+  backtrace_fd = watchdog->log_fd;
+  set_backtrace_handler (backtrace_handler);
+
+  watchdog_singleton = watchdog;
+  main_thread = pthread_self ();
+
+  context = g_main_context_default ();
+  watchdog->poll_func = g_main_context_get_poll_func (context);
+  g_main_context_set_poll_func (context, watchdog_poll);
+
+  g_atomic_int_set (&tracing, TRUE);
+
+  watchdog->thread = g_thread_new ("nd-watchdog", watchdog_thread_func,
+                                   watchdog);
+
+  return watchdog;
+}
+
+guint
+nd_watchdog_get_n_stalls (NdWatchdog *watchdog)
+{
+  g_return_val_if_fail (ND_IS_WATCHDOG (watchdog), 0);
+
+  return (guint) g_atomic_int_get ((gint *) &watchdog->n_stalls);
+}
+
+/* In ms */
+guint
+nd_watchdog_get_longest_stall (NdWatchdog *watchdog)
+{
+  g_return_val_if_fail (ND_IS_WATCHDOG (watchdog), 0);
+
+  return (guint) g_atomic_int_get ((gint *) &watchdog->longest_stall);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2026 Regolith Linux Contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ND_WATCHDOG_H
+#define ND_WATCHDOG_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define ND_TYPE_WATCHDOG nd_watchdog_get_type ()
+G_DECLARE_FINAL_TYPE (NdWatchdog, nd_watchdog, ND, WATCHDOG, GObject)
+
+NdWatchdog *nd_watchdog_new               (guint        threshold_ms);
+
+guint       nd_watchdog_get_n_stalls      (NdWatchdog  *watchdog);
+guint       nd_watchdog_get_longest_stall (NdWatchdog  *watchdog);
+
+void        nd_watchdog_trace             (const gchar *label);
+
+G_END_DECLS
+
+#endif